@@ -20,6 +20,9 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 
+#include "harness.h"
+#include "immediate.h"
+
 // Globals.
 static float R = 40.0; // Radius of circle.
 static float X = 50.0; // X-coordinate of center of circle.
@@ -77,11 +80,11 @@ void keyInput(unsigned char key, int x, int y)
             break;
         case '+':
             numVertices++;
-            glutPostRedisplay();
+            harnessPostRedisplay();
             break;
         case '-':
             if (numVertices > 3) numVertices--;
-            glutPostRedisplay();
+            harnessPostRedisplay();
             break;
         default:
             break;
@@ -101,24 +104,24 @@ void printInteraction(void)
 int main(int argc, char** argv)
 {
     printInteraction();
-    glutInit(&argc, argv);
+    harnessInit(&argc, argv);
 
     glutInitContextVersion(3, 1);
     glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
     glutInitDisplayMode(GLUT_SINGLE | GLUT_RGBA);
-    glutInitWindowSize(500, 500);
+    harnessInitWindowSize(500, 500);
     glutInitWindowPosition(100, 100);
-    glutCreateWindow("circle.cpp");
-    glutDisplayFunc(drawScene);
-    glutReshapeFunc(resize);
-    glutKeyboardFunc(keyInput);
+    harnessCreateWindow("circle.cpp");
+    harnessDisplayFunc(drawScene);
+    harnessReshapeFunc(resize);
+    harnessKeyboardFunc(keyInput);
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     setup();
 
-    glutMainLoop();
+    harnessMainLoop();
     return 0;
 }
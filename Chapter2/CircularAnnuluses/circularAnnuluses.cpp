@@ -20,6 +20,9 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 
+#include "harness.h"
+#include "immediate.h"
+
 #define N 40.0 // Number of vertices on the boundary of the disc.
 
 // Globals.
@@ -31,7 +34,7 @@ void writeBitmapString(void *font, char *string)
 {
     char *c;
 
-    for (c = string; *c != '\0'; c++) glutBitmapCharacter(font, *c);
+    for (c = string; *c != '\0'; c++) harnessBitmapCharacter(font, *c);
 }
 
 // Function to draw a disc with center at (X, Y, Z), radius R, parallel
@@ -134,7 +137,7 @@ void keyInput(unsigned char key, int x, int y)
             isWire = 1;
         else
             isWire = 0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 27:
         exit(0);
@@ -156,23 +159,23 @@ void printInteraction(void)
 int main(int argc, char **argv)
 {
     printInteraction();
-    glutInit(&argc, argv);
+    harnessInit(&argc, argv);
 
     glutInitContextVersion(3, 1);
     glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
     glutInitDisplayMode(GLUT_SINGLE | GLUT_RGBA | GLUT_DEPTH);
-    glutInitWindowSize(500, 500);
+    harnessInitWindowSize(500, 500);
     glutInitWindowPosition(100, 100);
-    glutCreateWindow("circularAnnuluses.cpp");
-    glutDisplayFunc(drawScene);
-    glutReshapeFunc(resize);
-    glutKeyboardFunc(keyInput);
+    harnessCreateWindow("circularAnnuluses.cpp");
+    harnessDisplayFunc(drawScene);
+    harnessReshapeFunc(resize);
+    harnessKeyboardFunc(keyInput);
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     setup();
 
-    glutMainLoop();
+    harnessMainLoop();
 }
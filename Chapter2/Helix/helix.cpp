@@ -15,6 +15,8 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 
+#include "harness.h"
+
 // Drawing routine.
 void drawScene(void)
 {
@@ -68,25 +70,25 @@ void keyInput(unsigned char key, int x, int y)
 // Main routine.
 int main(int argc, char **argv)
 {
-    glutInit(&argc, argv);
+    harnessInit(&argc, argv);
 
     glutInitContextVersion(3, 1);
     glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
     glutInitDisplayMode(GLUT_SINGLE | GLUT_RGBA);
-    glutInitWindowSize(500, 500);
+    harnessInitWindowSize(500, 500);
     glutInitWindowPosition(100, 100);
-    glutCreateWindow("helix.cpp");
-    glutDisplayFunc(drawScene);
-    glutReshapeFunc(resize);
-    glutKeyboardFunc(keyInput);
+    harnessCreateWindow("helix.cpp");
+    harnessDisplayFunc(drawScene);
+    harnessReshapeFunc(resize);
+    harnessKeyboardFunc(keyInput);
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     setup();
 
-    glutMainLoop();
+    harnessMainLoop();
 }
 
 
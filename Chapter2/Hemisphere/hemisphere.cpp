@@ -20,24 +20,34 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 
+#include "harness.h"
+#include "mesh.h"
+
 // Globals.
 static float R = 5.0; // Radius of hemisphere.
 static int p = 6; // Number of longitudinal slices.
 static int q = 4; // Number of latitudinal slices.
 // Angles to rotate hemisphere.
 static float Xangle = 0.0, Yangle = 0.0, Zangle = 0.0;
+static Mesh hemisphere; // Hemisphere mesh for the current p and q.
+
+// Routine to (re)build the hemisphere mesh after p or q changes.
+void buildHemisphere(void)
+{
+    meshDelete(hemisphere);
+    hemisphere = meshHemisphere(R, p, q);
+}
 
 // Initialization routine.
 void setup(void)
 {
     glClearColor(1.0, 1.0, 1.0, 0.0);
+    buildHemisphere();
 }
 
 // Drawing routine.
 void drawScene(void)
 {
-    int  i, j;
-
     glClear(GL_COLOR_BUFFER_BIT);
 
     glLoadIdentity();
@@ -57,25 +67,7 @@ void drawScene(void)
 
     // Array of latitudinal triangle strips, each parallel to the equator,
     // stacked one above the other from the equator to the north pole.
-    for (j = 0; j < q; j++)
-    {
-        // One latitudinal triangle strip.
-        glBegin(GL_TRIANGLE_STRIP);
-        for (i = 0; i <= p; i++)
-        {
-            glVertex3f(R * cos((float)(j + 1) / q * M_PI / 2.0)
-                       * cos(2.0 * (float)i / p * M_PI),
-                R * sin((float)(j + 1) / q * M_PI / 2.0),
-                -R * cos((float)(j + 1) / q * M_PI / 2.0)
-                       * sin(2.0 * (float)i / p * M_PI));
-            glVertex3f(R * cos((float)j / q * M_PI / 2.0)
-                       * cos(2.0 * (float)i / p * M_PI),
-                R * sin((float)j / q * M_PI / 2.0),
-                -R * cos((float)j / q * M_PI / 2.0)
-                       * sin(2.0 * (float)i / p * M_PI));
-        }
-        glEnd();
-    }
+    meshDraw(hemisphere);
 
     glFlush();
 }
@@ -100,49 +92,53 @@ void keyInput(unsigned char key, int x, int y)
         break;
     case 'P':
         p += 1;
-        glutPostRedisplay();
+        buildHemisphere();
+        harnessPostRedisplay();
         break;
     case 'p':
         if (p > 3) p -= 1;
-        glutPostRedisplay();
+        buildHemisphere();
+        harnessPostRedisplay();
         break;
     case 'Q':
         q += 1;
-        glutPostRedisplay();
+        buildHemisphere();
+        harnessPostRedisplay();
         break;
     case 'q':
         if (q > 3) q -= 1;
-        glutPostRedisplay();
+        buildHemisphere();
+        harnessPostRedisplay();
         break;
     case 'x':
         Xangle += 5.0;
         if (Xangle > 360.0) Xangle -= 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'X':
         Xangle -= 5.0;
         if (Xangle < 0.0) Xangle += 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'y':
         Yangle += 5.0;
         if (Yangle > 360.0) Yangle -= 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'Y':
         Yangle -= 5.0;
         if (Yangle < 0.0) Yangle += 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'z':
         Zangle += 5.0;
         if (Zangle > 360.0) Zangle -= 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'Z':
         Zangle -= 5.0;
         if (Zangle < 0.0) Zangle += 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     default:
         break;
@@ -165,24 +161,24 @@ void printInteraction(void)
 int main(int argc, char **argv)
 {
     printInteraction();
-    glutInit(&argc, argv);
+    harnessInit(&argc, argv);
 
     glutInitContextVersion(3, 1);
     glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
     glutInitDisplayMode(GLUT_SINGLE | GLUT_RGBA);
-    glutInitWindowSize(500, 500);
+    harnessInitWindowSize(500, 500);
     glutInitWindowPosition(100, 100);
-    glutCreateWindow("hemisphere.cpp");
-    glutDisplayFunc(drawScene);
-    glutReshapeFunc(resize);
-    glutKeyboardFunc(keyInput);
+    harnessCreateWindow("hemisphere.cpp");
+    harnessDisplayFunc(drawScene);
+    harnessReshapeFunc(resize);
+    harnessKeyboardFunc(keyInput);
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     setup();
 
-    glutMainLoop();
+    harnessMainLoop();
 }
 
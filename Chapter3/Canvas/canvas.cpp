@@ -18,6 +18,9 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 
+#include "harness.h"
+#include "immediate.h"
+
 #define INACTIVE 0
 #define POINT 1
 #define LINE 2
@@ -273,7 +276,7 @@ void drawScene(void)
     if (isGrid)
         drawGrid();
 
-    glutSwapBuffers();
+    harnessSwapBuffers();
 }
 
 // Function to pick primitive if click is in left selection area.
@@ -339,7 +342,7 @@ void mouseControl(int button, int state, int x, int y)
             }
         }
     }
-    glutPostRedisplay();
+    harnessPostRedisplay();
 }
 
 // OpenGL window reshape routine.
@@ -389,7 +392,7 @@ void rightMenu(int id)
     if (id == 1)
     {
         clearAll();
-        glutPostRedisplay();
+        harnessPostRedisplay();
     }
     if (id == 2) exit(0);
 }
@@ -399,7 +402,7 @@ void grid_menu(int id)
 {
     if (id == 3) isGrid = 1;
     if (id == 4) isGrid = 0;
-    glutPostRedisplay();
+    harnessPostRedisplay();
 }
 
 // Function to create menu.
@@ -422,7 +425,9 @@ void setup(void)
 {
     glClearColor(1.0, 1.0, 1.0, 0.0);
 
-    makeMenu(); // Create menu.
+    // Create menu. GLUT menus need a window, so there is none headless,
+    // and their choices are not input the harness can record.
+    if (!harnessIsHeadless()) makeMenu();
 }
 
 // Routine to output interaction instructions to the C++ window.
@@ -441,24 +446,24 @@ void printInteraction(void)
 int main(int argc, char **argv)
 {
     printInteraction();
-    glutInit(&argc, argv);
+    harnessInit(&argc, argv);
 
     glutInitContextVersion(3, 1);
     glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
     glutInitDisplayMode(GLUT_SINGLE | GLUT_RGBA);
-    glutInitWindowSize(500, 500);
+    harnessInitWindowSize(500, 500);
     glutInitWindowPosition(100, 100);
-    glutCreateWindow("canvas.cpp");
-    glutDisplayFunc(drawScene);
-    glutReshapeFunc(resize);
-    glutKeyboardFunc(keyInput);
-    glutMouseFunc(mouseControl);
+    harnessCreateWindow("canvas.cpp");
+    harnessDisplayFunc(drawScene);
+    harnessReshapeFunc(resize);
+    harnessKeyboardFunc(keyInput);
+    harnessMouseFunc(mouseControl);
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     setup();
 
-    glutMainLoop();
+    harnessMainLoop();
 }
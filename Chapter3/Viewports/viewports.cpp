@@ -14,6 +14,8 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 
+#include "harness.h"
+
 // Globals.
 static int width, height; // OpenGL window size.
 
@@ -101,24 +103,24 @@ void keyInput(unsigned char key, int x, int y)
 // Main routine.
 int main(int argc, char **argv)
 {
-    glutInit(&argc, argv);
+    harnessInit(&argc, argv);
 
     glutInitContextVersion(3, 1);
     glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
     glutInitDisplayMode(GLUT_SINGLE | GLUT_RGBA);
-    glutInitWindowSize(500, 500);
+    harnessInitWindowSize(500, 500);
     glutInitWindowPosition(100, 100);
-    glutCreateWindow("viewports.cpp");
-    glutDisplayFunc(drawScene);
-    glutReshapeFunc(resize);
-    glutKeyboardFunc(keyInput);
+    harnessCreateWindow("viewports.cpp");
+    harnessDisplayFunc(drawScene);
+    harnessReshapeFunc(resize);
+    harnessKeyboardFunc(keyInput);
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     setup();
 
-    glutMainLoop();
+    harnessMainLoop();
 }
 
@@ -5,7 +5,17 @@
 // (a) develop mode in which key frames are created.
 // (b) animate mode in which animation is shown.
 //
-// At the end of the develop mode configurations data is written to the file animateManDataOut.txt. 
+// At the end of the develop mode configurations data is written to the binary keyframe file
+// animateManDataOut.bin (see keyframes.h); only configurations new or changed since it was
+// last written are written again. Copy it to animateManDataIn.bin for animateMan2.cpp.
+//
+// The configurations are kept in a ChunkedSequence (see chunkedSequence.h), so creating,
+// resetting and deleting one stay quick with hundreds of thousands of them. The ghosted
+// configurations of each chunk are transformed into a vertex buffer of the chunk, redone
+// only when a configuration of the chunk changes, and drawn with one call per chunk.
+//
+// Edits to configurations are journaled (see editJournal.h) as the values they change,
+// so they can be undone and redone; the last JOURNAL_ENTRIES values changed are kept.
 //
 // Interaction:
 // Press a to toggle between develop and animate modes.
@@ -21,6 +31,7 @@
 // Press tab to choose a configuration - it is highlighted, others ghosted.
 // Press backspace to reset current configuration.
 // Press delete to delete current configuration.
+// Press u/U to undo/redo the last edit.
 //
 // In animate mode:
 // Press the up/down arrow keys to speed up/slow down animation.
@@ -34,19 +45,33 @@
 #include <iostream>
 #include <cmath>
 #include <vector>
-#include <fstream>
 
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 
+#include "harness.h"
+#include "shapeCache.h"
+
+#include "chunkedSequence.h"
+#include "editJournal.h"
+#include "keyframes.h"
+#include "skeleton.h"
+
+// Values changed the journal remembers, 16 bytes each.
+#define JOURNAL_ENTRIES 4096
+
 // Globals.
 static float highlightColor[3] = { 0.0, 0.0, 0.0 }; // Emphasize color.
 static float lowlightColor[3] = { 0.7, 0.7, 0.7 }; // De-emphasize color.
 static float partSelectColor[3] = { 1.0, 0.0, 0.0 }; // Selection indicate color.
 static long font = (long)GLUT_BITMAP_8_BY_13; // Font selection.
 static int animateMode = 0; // In animation mode?
+static Skeleton skeleton; // Rig of the man.
 static int animationPeriod = 1000; // Time interval between frames.
-static std::ofstream outFile; // File to write configurations data.
+static double animationTime = 0.0; // Time into the animation in frames - 2.5 is half-way
+                                   // from the third configuration to the fourth.
+static int lastTime; // Time of the last animation step.
+static KeyframeWriter outFile; // File to write configurations data.
 
 // Camera class.
 class Camera
@@ -111,9 +136,11 @@ public:
 
     void setHighlight(int inputHighlight) { highlight = inputHighlight; }
 
-    void draw();
-    void outputData();
-    void writeData();
+    void draw() const;
+    void transform(float *vertices) const;
+    void inputData(const float *values);
+    void outputData(float *values) const;
+    void writeData() const;
 
 private:
     // Man configuration values.
@@ -133,12 +160,27 @@ private:
     int highlight; // If man is currently selected.
 };
 
-// Global vector of man configurations.
-std::vector<Man> manVector;
+// Vertex buffer of the ghosted configurations of a chunk of men. Buffers of chunks
+// dropped are kept in freeBuffers for reuse, not deleted, as chunks may go after the
+// OpenGL context has.
+static std::vector<unsigned int> freeBuffers;
+struct GhostBatch
+{
+    unsigned int buffer = 0;
+    ~GhostBatch() { if (buffer) freeBuffers.push_back(buffer); }
+};
+
+// Global sequence of man configurations.
+ChunkedSequence<Man, GhostBatch> men;
 
-// Global iterators to traverse manVector.
-std::vector<Man>::iterator manVectorIterator;
-std::vector<Man>::iterator manVectorAnimationIterator;
+// Global index of the current configuration in men.
+size_t current;
+
+// Global array of the configurations in men as keyframes, for animate mode.
+std::vector<float> animationFrames;
+
+// Global journal of edits to men.
+EditJournal journal(JOURNAL_ENTRIES);
 
 // Man constructor.
 Man::Man()
@@ -171,191 +213,59 @@ void Man::decrementPartAngle()
     if (partAngles[selectedPart] < 0.0) partAngles[selectedPart] += 360.0;
 }
 
-// Function to draw man.
-void Man::draw()
+// Function to draw man: his parts posed by their angles after the up and forward
+// translations, all drawn at once (see skeleton.h).
+void Man::draw() const
 {
-    if (highlight || animateMode) glColor3fv(highlightColor);
-    else glColor3fv(lowlightColor);
-
-    glPushMatrix();
+    float root[16] = { 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0,
+                       0.0, upMove, forwardMove, 1.0 };
+    static std::vector<float> world, colors;
+    const float *color;
+    int i, k;
 
-    // Up and forward translations.
-    glTranslatef(0.0, upMove, forwardMove);
-
-    // Torso begin.
-    if (highlight && !animateMode) if (selectedPart == 0)
-        glColor3fv(partSelectColor);
-
-    glRotatef(partAngles[0], 1.0, 0.0, 0.0);
-
-    glPushMatrix();
-    glScalef(4.0, 16.0, 4.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Torso end.
-
-    // Head begin.
-    glPushMatrix();
-
-    glTranslatef(0.0, 11.5, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 3.0, 2.0);
-    glutWireSphere(1.0, 10, 8);
-    glPopMatrix();
-
-    glPopMatrix();
-    // Head end.
-
-    // Left upper and lower arm begin.
-    glPushMatrix();
-
-    // Left upper arm begin.
-    if (highlight && !animateMode) if (selectedPart == 1) glColor3fv(partSelectColor);
-    glTranslatef(3.0, 8.0, 0.0);
-    glRotatef(180.0 + partAngles[1], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, 4.0, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Left upper arm end.
-
-    // Left lower arm begin.
-    if (highlight && !animateMode) if (selectedPart == 2) glColor3fv(partSelectColor);
-    glTranslatef(0.0, 4.0, 0.0);
-    glRotatef(partAngles[2], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, 4.0, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Left lower arm end.
+    world.resize(16 * skeletonBones(skeleton));
+    colors.resize(3 * skeletonBones(skeleton));
+    skeletonPose(skeleton, root, partAngles, &world[0]);
 
-    glPopMatrix();
-    // Left upper and lower arm end.
-
-    // Right upper and lower arm begin.
-    glPushMatrix();
-
-    // Right upper arm begin.
-    if (highlight && !animateMode) if (selectedPart == 3) glColor3fv(partSelectColor);
-    glTranslatef(-3.0, 8.0, 0.0);
-    glRotatef(180.0 + partAngles[3], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, 4.0, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Right upper arm end.
-
-    // Right lower arm begin.
-    if (highlight && !animateMode) if (selectedPart == 4) glColor3fv(partSelectColor);
-    glTranslatef(0.0, 4.0, 0.0);
-    glRotatef(partAngles[4], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, 4.0, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Right lower arm end.
-
-    glPopMatrix();
-    // Right upper and lower arm end.
-
-    // Left upper and lower leg with foot begin.
-    glPushMatrix();
-
-    // Left upper leg begin.
-    if (highlight && !animateMode) if (selectedPart == 5) glColor3fv(partSelectColor);
-    glTranslatef(1.5, -8.0, 0.0);
-    glRotatef(partAngles[5], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, -4.0, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Left upper leg end.
-
-    // Left lower leg with foot begin.
-    if (highlight && !animateMode) if (selectedPart == 6) glColor3fv(partSelectColor);
-    glTranslatef(0.0, -4.0, 0.0);
-    glRotatef(partAngles[6], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, -4.0, 0.0);
-
-    // Lower leg.
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-
-    // Foot.
-    glTranslatef(0.0, -5.0, 0.5);
-    glPushMatrix();
-    glScalef(2.0, 1.0, 3.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Left lower leg with foot end.
-
-    glPopMatrix();
-    // Left upper and lower leg with foot end.
-
-    // Right upper and lower leg with foot begin.
-    glPushMatrix();
-
-    // Right upper leg begin.
-    if (highlight && !animateMode) if (selectedPart == 7) glColor3fv(partSelectColor);
-    glTranslatef(-1.5, -8.0, 0.0);
-    glRotatef(partAngles[7], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, -4.0, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Right upper leg end.
-
-    // Right lower leg with foot begin.
-    if (highlight && !animateMode) if (selectedPart == 8) glColor3fv(partSelectColor);
-    glTranslatef(0.0, -4.0, 0.0);
-    glRotatef(partAngles[8], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, -4.0, 0.0);
-
-    // Lower leg.
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-
-    // Foot.
-    glTranslatef(0.0, -5.0, 0.5);
-    glPushMatrix();
-    glScalef(2.0, 1.0, 3.0);
-    glutWireCube(1.0);
-    glPopMatrix();
+    for (i = 0; i < skeletonBones(skeleton); i++)
+    {
+        if (highlight || animateMode) color = highlightColor;
+        else color = lowlightColor;
+        if (highlight && !animateMode && skeleton.part[i] == selectedPart)
+            color = partSelectColor;
+        for (k = 0; k < 3; k++) colors[3 * i + k] = color[k];
+    }
+    skeletonDraw(skeleton, &world[0], &colors[0]);
+}
 
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Right lower leg with foot end.
+// Function to write the vertices of man, posed, for skeletonDrawBatch().
+void Man::transform(float *vertices) const
+{
+    float root[16] = { 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0,
+                       0.0, upMove, forwardMove, 1.0 };
+    static std::vector<float> world;
 
-    glPopMatrix();
-    // Right upper and lower leg with foot end.
+    world.resize(16 * skeletonBones(skeleton));
+    skeletonPose(skeleton, root, partAngles, &world[0]);
+    skeletonTransform(skeleton, &world[0], vertices);
+}
 
-    glPopMatrix();
+// Function to set configuration from the KEYFRAME_FLOATS values of a keyframe.
+void Man::inputData(const float *values)
+{
+    int i;
+    for (i = 0; i < 9; i++) partAngles[i] = values[i];
+    upMove = values[9];
+    forwardMove = values[10];
 }
 
-// Function to output configurations data to file.
-void Man::outputData()
+// Function to output configuration data as the KEYFRAME_FLOATS values of a keyframe.
+void Man::outputData(float *values) const
 {
     int i;
-    for (i = 0; i < 9; i++) outFile << partAngles[i] << " ";
-    outFile << upMove << " " << forwardMove << std::endl;
+    for (i = 0; i < 9; i++) values[i] = partAngles[i];
+    values[9] = upMove;
+    values[10] = forwardMove;
 }
 
 // Routine to draw a bitmap character string.
@@ -364,7 +274,7 @@ void writeBitmapString(void *font, std::string string)
     char *c;
     char s[string.length() + 1];
 
-    for (c = s; *c != '\0'; c++) glutBitmapCharacter(font, *c);
+    for (c = s; *c != '\0'; c++) harnessBitmapCharacter(font, *c);
 }
 
 // Routine to convert floating point to char string.
@@ -375,7 +285,7 @@ void floatToString(char * destStr, int precision, float val)
 }
 
 // Routine to write configurations data.
-void Man::writeData()
+void Man::writeData() const
 {
     char buffer[33];
 
@@ -446,6 +356,36 @@ void Man::writeData()
     writeBitmapString((void*)font, buffer);
 }
 
+// Routine to draw the men of a chunk ghosted, first refilling its vertex buffer if
+// they have changed.
+void drawGhosts(ChunkedSequence<Man, GhostBatch>::Chunk &chunk)
+{
+    static std::vector<float> vertices;
+    size_t floats = 3 * skeleton.vertexBone.size(), i;
+
+    if (chunk.cache.buffer == 0)
+    {
+        if (freeBuffers.empty()) glGenBuffers(1, &chunk.cache.buffer);
+        else
+        {
+            chunk.cache.buffer = freeBuffers.back();
+            freeBuffers.pop_back();
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, chunk.cache.buffer);
+    if (chunk.stale)
+    {
+        vertices.resize(floats * chunk.items.size());
+        for (i = 0; i < chunk.items.size(); i++)
+            chunk.items[i].transform(&vertices[floats * i]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), &vertices[0],
+                     GL_STATIC_DRAW);
+        chunk.stale = 0;
+    }
+    skeletonDrawBatch(skeleton, chunk.items.size(), lowlightColor);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 // Drawing routine.
 void drawScene(void)
 {
@@ -460,7 +400,7 @@ void drawScene(void)
     if (!animateMode)
     {
         writeBitmapString((void*)font, "DEVELOP MODE");
-        manVectorIterator->writeData();
+        men[current].writeData();
     }
     else writeBitmapString((void*)font, "ANIMATE MODE");
     glPopMatrix();
@@ -475,13 +415,22 @@ void drawScene(void)
 
     if (!animateMode) // Develop mode.
     {
-        // Draw all the configurations in manVector.
-        for (auto man : manVector) { man.draw(); }
+        // Draw all the configurations ghosted, chunk by chunk, then the current one
+        // over its ghost.
+        for (size_t c = 0; c < men.chunkCount(); c++) drawGhosts(men.chunk(c));
+        men[current].draw();
     }
     else // Animated mode - 
-         // use separate iterator so as to leave develop mode iterator unchanged.
+         // draw the configuration at the current time, between keyframes.
     {
-        manVectorAnimationIterator->draw();
+        float pose[KEYFRAME_FLOATS];
+        Man man;
+        // The frames written on entering animate mode; men may have been
+        // edited since.
+        keyframesPose(&animationFrames[0],
+                      animationFrames.size() / KEYFRAME_STRIDE, animationTime, pose);
+        man.inputData(pose);
+        man.draw();
     }
 
     // Other (fixed) objects in scene are drawn below starting here.
@@ -505,32 +454,104 @@ void drawScene(void)
     glTranslatef(0.0, -20.0, 10.0);
     glPushMatrix();
     glScalef(5.0, 5.0, 5.0);
-    glutWireSphere(1.0, 10, 8);
+    shapeCacheWireSphere(1.0, 10, 8);
     glPopMatrix();
 
-    glutSwapBuffers();
+    harnessSwapBuffers();
 }
 
-// Timer function.
-void animate(int value)
+// Idle function: advances the animation by the time since the last step, so it plays
+// at display rate.
+void animate(void)
 {
-    if (animateMode)
-    {
-        manVectorAnimationIterator++;
-        if (manVectorAnimationIterator == manVector.end())
-            manVectorAnimationIterator = manVector.begin();
+    int time = harnessElapsedTime();
 
-        glutPostRedisplay();
-        glutTimerFunc(animationPeriod, animate, 1);
-    }
+    animationTime += (double)(time - lastTime) / animationPeriod;
+    lastTime = time;
+    harnessPostRedisplay();
 }
 
-// Function to write configurations to file.
+// Function to write configurations to file, keeping them in animationFrames.
 void outputConfigurations(void)
 {
-    outFile.open("animateManDataOut.txt");
-    for (auto man : manVector) { man.outputData(); }
-    outFile.close();
+    size_t c, k, i;
+
+    animationFrames.resize(KEYFRAME_STRIDE * men.size());
+    for (c = 0, i = 0; c < men.chunkCount(); c++)
+        for (k = 0; k < men.chunk(c).items.size(); k++, i++)
+            men.chunk(c).items[k].outputData(&animationFrames[KEYFRAME_STRIDE * i]);
+    if (keyframeWriterSync(outFile, &animationFrames[0], men.size()) < 0)
+        std::cerr << "animateManDataOut.bin: write failed" << std::endl;
+}
+
+// Routine to journal the changes to configuration index, whose values were before.
+void journalChanges(size_t index, const float *before)
+{
+    float after[KEYFRAME_FLOATS];
+    int i;
+
+    men[index].outputData(after);
+    for (i = 0; i < KEYFRAME_FLOATS; i++)
+        if (after[i] != before[i])
+            journal.record(JOURNAL_SET, index, i, before[i], after[i]);
+}
+
+// Routine to insert man before configuration index, journaled as the insertion of a
+// blank configuration and the setting of its values.
+void insertMan(size_t index, const Man &man)
+{
+    float blank[KEYFRAME_FLOATS] = { 0.0 };
+
+    men.insert(index, man);
+    journal.record(JOURNAL_INSERT, index, 0, 0.0, 0.0);
+    journalChanges(index, blank);
+}
+
+// Routine to erase configuration index, journaled as the clearing of its values and
+// the erasure of a blank configuration.
+void eraseMan(size_t index)
+{
+    float values[KEYFRAME_FLOATS];
+    int i;
+
+    men[index].outputData(values);
+    for (i = 0; i < KEYFRAME_FLOATS; i++)
+        if (values[i] != 0.0) journal.record(JOURNAL_SET, index, i, values[i], 0.0);
+    men.erase(index);
+    journal.record(JOURNAL_ERASE, index, 0, 0.0, 0.0);
+}
+
+// Routine to apply the entries of a command from the journal, undoing them if undo,
+// else redoing them. The last configuration changed becomes the current one.
+void applyCommand(const std::vector<JournalEntry> &command, int undo)
+{
+    float values[KEYFRAME_FLOATS];
+    Man blank;
+    size_t i;
+    int op;
+
+    men.edit(current).setHighlight(0);
+    blank.setHighlight(0);
+    for (i = 0; i < command.size(); i++)
+    {
+        const JournalEntry &entry = command[i];
+
+        op = entry.op;
+        if (undo && op == JOURNAL_INSERT) op = JOURNAL_ERASE;
+        else if (undo && op == JOURNAL_ERASE) op = JOURNAL_INSERT;
+
+        if (op == JOURNAL_SET)
+        {
+            men[entry.index].outputData(values);
+            values[entry.field] = undo ? entry.before : entry.after;
+            men.edit(entry.index).inputData(values);
+        }
+        else if (op == JOURNAL_INSERT) men.insert(entry.index, blank);
+        else men.erase(entry.index);
+        current = entry.index;
+    }
+    if (current >= men.size()) current = men.size() - 1;
+    men.edit(current).setHighlight(1);
 }
 
 // Initialization routine.
@@ -538,12 +559,15 @@ void setup(void)
 {
     glClearColor(1.0, 1.0, 1.0, 0.0);
 
-    // Initialize global manVector with single configuration.
-    manVector.push_back(Man());
+    // Build the rig of the man.
+    skeleton = skeletonMan();
 
-    // Initialize global iterators for manVector.
-    manVectorIterator = manVector.begin();
-    manVectorAnimationIterator = manVector.begin();
+    // Initialize global men with single configuration.
+    men.insert(0, Man());
+    current = 0;
+
+    // Open file for configurations data.
+    keyframeWriterOpen(outFile, "animateManDataOut.bin");
 
     // Initialize camera.
     camera = Camera();
@@ -563,7 +587,10 @@ void resize(int w, int h)
 // Keyboard input processing routine.
 void keyInput(unsigned char key, int x, int y)
 {
-   std::vector<Man>::iterator localManVectorIterator;
+     Man man;
+    float before[KEYFRAME_FLOATS];
+    std::vector<JournalEntry> command;
+
     switch (key)
     {
     case 27:
@@ -572,109 +599,110 @@ void keyInput(unsigned char key, int x, int y)
     case 'a': // Toggle between develop and animate modes.
         if (animateMode == 0)
         {
-            manVectorAnimationIterator = manVector.begin();
             outputConfigurations(); // Write configurations data to file at end of develop mode.
+            animationTime = 0.0;
+            lastTime = harnessElapsedTime();
             animateMode = 1;
-            animate(1);
+            harnessIdleFunc(animate);
         }
-        else animateMode = 0;
-        glutPostRedisplay();
+        else
+        {
+            animateMode = 0;
+            harnessIdleFunc(NULL);
+        }
+        harnessPostRedisplay();
         break;
     case 'r': // Rotate camera.
         camera.incrementViewDirection();
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'R': // Rotate camera.
         camera.decrementViewDirection();
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'z': // Zoom in.
         camera.decrementZoomDistance();
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'Z': // Zoom out.
         camera.incrementZoomDistance();
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'n': // Create new man configuration.
               // Turn highlight off current configuration.
-        manVectorIterator->setHighlight(0);
+        men.edit(current).setHighlight(0);
 
-        localManVectorIterator = manVectorIterator;
-        manVectorIterator++;
+        // Insert copy of current configuration after it and highlight.
+        man = men[current];
+        man.setHighlight(1);
+        insertMan(++current, man);
+        journal.commit();
 
-        // Insert copy of current configuration and highlight.
-        manVectorIterator =
-            manVector.insert(manVectorIterator, Man(*localManVectorIterator));
-        manVectorIterator->setHighlight(1);
-
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case ' ': // Select next body part.
-        manVectorIterator->incrementSelectedPart();
+        men.edit(current).incrementSelectedPart();
 
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
 
         // Tab - select next man configuration.
     case 9:
         // Turn highlight off current configuration.
-        manVectorIterator->setHighlight(0);
+        men.edit(current).setHighlight(0);
 
-        // Increment iterator - go to start if at end already.
-        manVectorIterator++;
-        if (manVectorIterator == manVector.end())
-            manVectorIterator = manVector.begin();
+        // Go to next configuration - go to start if at end already.
+        current++;
+        if (current == men.size()) current = 0;
 
         // Highlight current configuration.
-        manVectorIterator->setHighlight(1);
+        men.edit(current).setHighlight(1);
 
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
 
         // Backspace - reset current man configuration,
     case 8:
-        if (manVectorIterator != manVector.begin()) // Not first configuration. 
+        men[current].outputData(before);
+        if (current != 0) // Not first configuration.
         {
-            // Make copy of the previous configuration and highlight.
-            localManVectorIterator = manVectorIterator;
-            localManVectorIterator--;
-            manVectorIterator =
-                manVector.insert(manVectorIterator, Man(*localManVectorIterator));
-            manVectorIterator->setHighlight(1);
-
-            // Delete current configuration.
-            manVectorIterator++;
-            manVectorIterator = manVector.erase(manVectorIterator);
-
-            // Return iterator.
-            manVectorIterator--;
+            // Replace with copy of the previous configuration and highlight.
+            man = men[current - 1];
+            man.setHighlight(1);
+            men.edit(current) = man;
         }
         else // First configuration
         {
-            // Delete the current configuration.
-            manVectorIterator = manVector.erase(manVectorIterator);
-
-            // Create new configuration.
-            manVector.insert(manVectorIterator, Man());
+            // Replace with new configuration.
+            men.edit(current) = Man();
         }
+        journalChanges(current, before);
+        journal.commit();
 
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
 
         // Delete - delete current man configuration.
     case 127:
-        if (manVector.size() > 1)
+        if (men.size() > 1)
         {
-            manVectorIterator = manVector.erase(manVectorIterator);
-            if (manVectorIterator != manVector.begin())
-                manVectorIterator--;
+            eraseMan(current);
+            journal.commit();
+            if (current != 0) current--;
 
             // Highlight current configuration.
-            manVectorIterator->setHighlight(1);
+            men.edit(current).setHighlight(1);
         }
 
-        glutPostRedisplay();
+        harnessPostRedisplay();
+        break;
+    case 'u': // Undo last edit.
+        if (journal.undo(command)) applyCommand(command, 1);
+        harnessPostRedisplay();
+        break;
+    case 'U': // Redo last edit undone.
+        if (journal.redo(command)) applyCommand(command, 0);
+        harnessPostRedisplay();
         break;
     default:
         break;
@@ -684,21 +712,26 @@ void keyInput(unsigned char key, int x, int y)
 // Callback routine for non-ASCII key entry.
 void specialKeyInput(int key, int x, int y)
 {
-    if (key == GLUT_KEY_PAGE_DOWN) manVectorIterator->decrementPartAngle();
-    if (key == GLUT_KEY_PAGE_UP) manVectorIterator->incrementPartAngle();
-    if (key == GLUT_KEY_LEFT) manVectorIterator->decrementForwardMove();
-    if (key == GLUT_KEY_RIGHT) manVectorIterator->incrementForwardMove();
+    float before[KEYFRAME_FLOATS];
+
+    men[current].outputData(before);
+    if (key == GLUT_KEY_PAGE_DOWN) men.edit(current).decrementPartAngle();
+    if (key == GLUT_KEY_PAGE_UP) men.edit(current).incrementPartAngle();
+    if (key == GLUT_KEY_LEFT) men.edit(current).decrementForwardMove();
+    if (key == GLUT_KEY_RIGHT) men.edit(current).incrementForwardMove();
     if (key == GLUT_KEY_DOWN)
     {
-        if (!animateMode) manVectorIterator->decrementUpMove();
+        if (!animateMode) men.edit(current).decrementUpMove();
         else animationPeriod += 10;
     }
     if (key == GLUT_KEY_UP)
     {
-        if (!animateMode) manVectorIterator->incrementUpMove();
+        if (!animateMode) men.edit(current).incrementUpMove();
         else if (animationPeriod > 10) animationPeriod -= 10;
     }
-    glutPostRedisplay();
+    journalChanges(current, before);
+    journal.commit();
+    harnessPostRedisplay();
 }
 
 // Routine to output interaction instructions to the C++ window.
@@ -718,6 +751,7 @@ void printInteraction(void)
         << "Press tab to choose a configuration - it is highlighted, others ghosted." << std::endl
         << "Press backspace to reset current configuration." << std::endl
         << "Press delete to delete current configuration." << std::endl
+        << "Press u/U to undo/redo the last edit." << std::endl
         << std::endl
         << "In animate mode:" << std::endl
         << "Press the up/down arrow keys to speed up/slow down animation." << std::endl;
@@ -727,25 +761,25 @@ void printInteraction(void)
 int main(int argc, char **argv)
 {
     printInteraction();
-    glutInit(&argc, argv);
+    harnessInit(&argc, argv);
 
     glutInitContextVersion(3, 1);
     glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
-    glutInitWindowSize(500, 500);
+    harnessInitWindowSize(500, 500);
     glutInitWindowPosition(100, 100);
-    glutCreateWindow("animateMan1.cpp");
-    glutDisplayFunc(drawScene);
-    glutReshapeFunc(resize);
-    glutKeyboardFunc(keyInput);
-    glutSpecialFunc(specialKeyInput);
+    harnessCreateWindow("animateMan1.cpp");
+    harnessDisplayFunc(drawScene);
+    harnessReshapeFunc(resize);
+    harnessKeyboardFunc(keyInput);
+    harnessSpecialFunc(specialKeyInput);
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     setup();
 
-    glutMainLoop();
+    harnessMainLoop();
 }
 
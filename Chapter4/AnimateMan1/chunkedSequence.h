@@ -0,0 +1,192 @@
+/////////////////////////////////////////////////////////////////////////////
+// chunkedSequence.h
+//
+// A sequence of items stored in chunks of at most MAX_CHUNK, for the
+// configurations of animateMan1.cpp, which can run to hundreds of
+// thousands while being edited anywhere.
+//
+// Items are addressed by position. A Fenwick tree over the chunk sizes
+// finds the chunk of a position in O(log n); inserting or erasing then
+// moves at most MAX_CHUNK items of that chunk and updates the tree in
+// O(log n). A full chunk is split in two and an empty one dropped, which
+// rebuilds the tree, but only once every MAX_CHUNK / 2 edits at most.
+//
+// Each chunk also carries a Cache, data derived from its items by the
+// caller (animateMan1.cpp keeps the drawing of its men there), and a stale
+// flag the sequence sets whenever the chunk's items change, so the caller
+// need only rebuild the caches of chunks that were edited. Items are read
+// through operator[] and changed through edit(), which marks their chunk.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef CHUNKED_SEQUENCE_H
+#define CHUNKED_SEQUENCE_H
+
+#include <cstddef>
+#include <vector>
+
+template <class T, class Cache>
+class ChunkedSequence
+{
+public:
+    enum { MAX_CHUNK = 512 };
+
+    struct Chunk
+    {
+        std::vector<T> items;
+        Cache cache;
+        int stale = 1; // Have the items changed since the cache was built?
+    };
+
+    ChunkedSequence() : count(0) {}
+    ~ChunkedSequence() { clear(); }
+
+    size_t size() const { return count; }
+    const T &operator[](size_t i) const;
+    T &edit(size_t i);
+    void insert(size_t i, const T &item);
+    void erase(size_t i);
+    void clear();
+
+    // The chunks in order, for work on whole runs of items.
+    size_t chunkCount() const { return chunks.size(); }
+    Chunk &chunk(size_t c) { return *chunks[c]; }
+
+private:
+    ChunkedSequence(const ChunkedSequence &);
+    ChunkedSequence &operator=(const ChunkedSequence &);
+
+    size_t locate(size_t i, size_t &offset) const;
+    void add(size_t c, long delta);
+    void rebuild();
+
+    std::vector<Chunk *> chunks;
+    std::vector<size_t> tree; // Fenwick tree of chunk sizes, 1-based.
+    size_t count;
+};
+
+// Routine to return the chunk holding position i, and i's offset in it.
+// Position size() is found at the end of the last chunk.
+template <class T, class Cache>
+size_t ChunkedSequence<T, Cache>::locate(size_t i, size_t &offset) const
+{
+    size_t c = 0, step;
+
+    if (i == count)
+    {
+        offset = chunks.back()->items.size();
+        return chunks.size() - 1;
+    }
+
+    // Descend the tree for the last chunk c with fewer than i + 1 items
+    // before it ends; i is then in chunk c.
+    for (step = 1; step * 2 <= chunks.size(); step *= 2);
+    for (; step > 0; step /= 2)
+        if (c + step <= chunks.size() && tree[c + step] <= i)
+        {
+            c += step;
+            i -= tree[c];
+        }
+    offset = i;
+    return c;
+}
+
+// Routine to add delta to the size of chunk c in the tree.
+template <class T, class Cache>
+void ChunkedSequence<T, Cache>::add(size_t c, long delta)
+{
+    for (c++; c < tree.size(); c += c & (0 - c)) tree[c] += delta;
+}
+
+// Routine to rebuild the tree after chunks were added or removed.
+template <class T, class Cache>
+void ChunkedSequence<T, Cache>::rebuild()
+{
+    size_t c, parent;
+
+    tree.assign(chunks.size() + 1, 0);
+    for (c = 1; c <= chunks.size(); c++)
+    {
+        tree[c] += chunks[c - 1]->items.size();
+        parent = c + (c & (0 - c));
+        if (parent <= chunks.size()) tree[parent] += tree[c];
+    }
+}
+
+template <class T, class Cache>
+const T &ChunkedSequence<T, Cache>::operator[](size_t i) const
+{
+    size_t offset, c = locate(i, offset);
+    return chunks[c]->items[offset];
+}
+
+template <class T, class Cache>
+T &ChunkedSequence<T, Cache>::edit(size_t i)
+{
+    size_t offset, c = locate(i, offset);
+    chunks[c]->stale = 1;
+    return chunks[c]->items[offset];
+}
+
+// Routine to insert item before position i, or at the end if i is size().
+template <class T, class Cache>
+void ChunkedSequence<T, Cache>::insert(size_t i, const T &item)
+{
+    size_t offset, c;
+    Chunk *half;
+
+    if (chunks.empty())
+    {
+        chunks.push_back(new Chunk());
+        rebuild();
+    }
+    c = locate(i, offset);
+    chunks[c]->items.insert(chunks[c]->items.begin() + offset, item);
+    chunks[c]->stale = 1;
+    count++;
+
+    if (chunks[c]->items.size() <= MAX_CHUNK)
+    {
+        add(c, 1);
+        return;
+    }
+
+    // Split the full chunk, its second half going to a new chunk after it.
+    half = new Chunk();
+    half->items.assign(chunks[c]->items.begin() + MAX_CHUNK / 2,
+                       chunks[c]->items.end());
+    chunks[c]->items.resize(MAX_CHUNK / 2);
+    chunks.insert(chunks.begin() + c + 1, half);
+    rebuild();
+}
+
+template <class T, class Cache>
+void ChunkedSequence<T, Cache>::erase(size_t i)
+{
+    size_t offset, c = locate(i, offset);
+
+    chunks[c]->items.erase(chunks[c]->items.begin() + offset);
+    chunks[c]->stale = 1;
+    count--;
+
+    if (!chunks[c]->items.empty())
+    {
+        add(c, -1);
+        return;
+    }
+    delete chunks[c];
+    chunks.erase(chunks.begin() + c);
+    rebuild();
+}
+
+template <class T, class Cache>
+void ChunkedSequence<T, Cache>::clear()
+{
+    size_t c;
+
+    for (c = 0; c < chunks.size(); c++) delete chunks[c];
+    chunks.clear();
+    tree.clear();
+    count = 0;
+}
+
+#endif
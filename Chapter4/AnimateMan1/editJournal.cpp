@@ -0,0 +1,70 @@
+/////////////////////////////////////////////////////////////////////////////
+// editJournal.cpp
+//
+// Implementation of the edit journal declared in editJournal.h.
+/////////////////////////////////////////////////////////////////////////////
+
+#include "editJournal.h"
+
+// Journal constructor.
+EditJournal::EditJournal(size_t capacity)
+{
+    ring.resize(capacity);
+    start = 0;
+    done = 0;
+    end = 0;
+    recording = 0;
+}
+
+void EditJournal::record(JournalOp op, size_t index, int field, float before,
+                         float after)
+{
+    JournalEntry *entry;
+
+    // A new command replaces the commands undone.
+    if (!recording) end = done;
+
+    // Drop the oldest command if full.
+    if (end - start == ring.size())
+        for (start++; start < end && !ring[start % ring.size()].first; start++);
+
+    entry = &ring[end % ring.size()];
+    entry->index = index;
+    entry->op = op;
+    entry->field = field;
+    entry->first = !recording;
+    entry->before = before;
+    entry->after = after;
+    end++;
+    recording = 1;
+}
+
+void EditJournal::commit()
+{
+    if (recording) done = end;
+    recording = 0;
+}
+
+int EditJournal::undo(std::vector<JournalEntry> &command)
+{
+    command.clear();
+    if (recording || done == start) return 0;
+    do
+    {
+        done--;
+        command.push_back(ring[done % ring.size()]);
+    } while (!command.back().first);
+    return 1;
+}
+
+int EditJournal::redo(std::vector<JournalEntry> &command)
+{
+    command.clear();
+    if (recording || done == end) return 0;
+    do
+    {
+        command.push_back(ring[done % ring.size()]);
+        done++;
+    } while (done < end && !ring[done % ring.size()].first);
+    return 1;
+}
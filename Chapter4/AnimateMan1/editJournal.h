@@ -0,0 +1,66 @@
+/////////////////////////////////////////////////////////////////////////////
+// editJournal.h
+//
+// Undo and redo of the edits of animateMan1.cpp's develop mode.
+//
+// The journal holds no configurations, only what changed: an edit is a
+// command of a few 16-byte entries, each setting one value of one
+// configuration (a part angle or move, with its value before and after),
+// inserting a configuration or erasing one. Configurations are only ever
+// inserted and erased with all their values zero, the values being set or
+// cleared by entries of their own, so a whole configuration deleted costs
+// at most 12 entries and one whose part was turned costs 1.
+//
+// Entries are kept in a ring of fixed capacity; when it is full the oldest
+// commands are dropped, so memory is bounded however long the session.
+// Undoing or redoing a command returns its entries, in the order to apply
+// them, without touching any other command.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef EDIT_JOURNAL_H
+#define EDIT_JOURNAL_H
+
+#include <cstddef>
+#include <vector>
+
+enum JournalOp { JOURNAL_SET, JOURNAL_INSERT, JOURNAL_ERASE };
+
+// An entry: to do it, set value field of configuration index from before to
+// after, or insert or erase configuration index.
+struct JournalEntry
+{
+    unsigned int index;
+    unsigned char op; // JournalOp.
+    unsigned char field; // KEYFRAME_FLOATS index of the value set.
+    unsigned char first; // Is this the first entry of its command?
+    float before, after;
+};
+
+class EditJournal
+{
+public:
+    // A journal of capacity entries, more than the longest command.
+    EditJournal(size_t capacity);
+
+    // Routines to build a command: record() its entries in order, then
+    // commit() it, which discards any commands undone before it. A command
+    // with no entries is not kept.
+    void record(JournalOp op, size_t index, int field, float before, float after);
+    void commit();
+
+    // Routines to write to command the entries of the last command done, in
+    // the order to undo them, or of the next command undone, in the order to
+    // redo them. Each returns 0, leaving command empty, if there is none.
+    int undo(std::vector<JournalEntry> &command);
+    int redo(std::vector<JournalEntry> &command);
+
+private:
+    std::vector<JournalEntry> ring;
+    // Entries ever written, counting from the oldest kept (start), the next
+    // to undo after (done) and the end of the redo or pending entries (end);
+    // entry n is ring[n % ring.size()].
+    unsigned long start, done, end;
+    int recording; // Are entries at done a command being recorded?
+};
+
+#endif
@@ -2,10 +2,16 @@
 // animateMan2.cpp
 //
 // This program, based on animatedMan1.cpp, runs the animation of the man by reading
-// configurations from the file animateManDataIn.txt.
+// configurations from the file animateManDataIn.clip, animateManDataIn.bin or, failing
+// those, animateManDataIn.txt.
 //
-// EXECUTION NOTE: A file animateManDataIn.txt (best generated by animatedMan1.cpp)
-// containing correctly formatted data must be in the same directory.
+// EXECUTION NOTE: A file animateManDataIn.bin (best generated by animatedMan1.cpp, or
+// converted from text by KeyframeConvert) or animateManDataIn.txt containing correctly
+// formatted data must be in the same directory. The binary file is mapped and its
+// configurations drawn straight from the mapping (see keyframes.h), so however many there
+// are loading takes no time. So is the compressed clip animateManDataIn.clip, made from
+// either by KeyframeConvert, whose configurations are decoded as they are played (see
+// keyframeClip.h).
 //
 // Interaction:
 // Press a to toggle between animation on/off.
@@ -13,6 +19,15 @@
 // Press r/R to rotate the viewpoint.
 // Press z/Z to zoom in/out.
 //
+// Crowd mode: run with --crowd N to animate N men at once, each at its own phase of
+// the animation, their poses evaluated on all hardware threads and drawn instanced,
+// skinned on the GPU (see crowd.h; --no-skinning evaluates their bone matrices on the
+// CPU and --no-instancing draws them one by one). Animation starts at once, so
+//
+//     ./prog42 --headless --frames 300 --crowd 10000
+//
+// benchmarks it; the poses evaluated per second are written at exit.
+//
 //
 //Sumanta Guha.
 ////////////////////////////////////////////////////////////////////////////////////
@@ -20,22 +35,40 @@
 #define _USE_MATH_DEFINES 
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <cmath>
 #include <vector>
-#include <fstream>
+#include <unistd.h>
 
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 
+#include "harness.h"
+#include "frameStats.h"
+#include "shapeCache.h"
+#include "workerPool.h"
+
+#include "keyframes.h"
+#include "keyframeClip.h"
+#include "skeleton.h"
+#include "crowd.h"
+
 // Globals.
 static float highlightColor[3] = { 0.0, 0.0, 0.0 }; // Emphasize color.
 static float lowlightColor[3] = { 0.7, 0.7, 0.7 }; // De-emphasize color.
 static float partSelectColor[3] = { 1.0, 0.0, 0.0 }; // Selection indicate color.
 static int animateMode = 0; // In animation mode?
+static Skeleton skeleton; // Rig of the man.
 static int animationPeriod = 1000; // Time interval between frames.
-static std::ofstream outFile; // File to write configurations data.
-static std::ifstream inFile; // File to read configurations data.
+static double animationTime = 0.0; // Time into the animation in frames - 2.5 is half-way
+                                   // from the third configuration to the fourth.
+static int lastTime; // Time of the last animation step.
+static KeyframeSet keyframes; // Configurations data read from file.
+static KeyframeClip clip; // Compressed configurations, if played from a clip.
+static int crowdSize = 0; // Men in crowd mode, 0 for the single man.
+static int instancing = 1; // Draw the crowd instanced if supported?
+static Crowd crowd; // The men of crowd mode.
 
 // Camera class.
 class Camera
@@ -101,7 +134,7 @@ public:
     void setHighlight(int inputHighlight) { highlight = inputHighlight; }
 
     void draw();
-    void outputData();
+    void inputData(const float *values);
     void writeData();
 
 private:
@@ -122,13 +155,6 @@ private:
     int highlight; // If man is currently selected.
 };
 
-// Global vector of man configurations.
-std::vector<Man> manVector;
-
-// Global iterators to traverse manVector.
-std::vector<Man>::iterator manVectorIterator;
-std::vector<Man>::iterator manVectorAnimationIterator;
-
 // Man constructor.
 Man::Man()
 {
@@ -146,182 +172,38 @@ void Man::incrementSelectedPart()
     else selectedPart = 0;
 }
 
-// Function to draw man.
-void Man::draw()
+// Function to set configuration from the KEYFRAME_FLOATS values of a keyframe.
+void Man::inputData(const float *values)
 {
-    if (highlight || animateMode) glColor3fv(highlightColor);
-    else glColor3fv(lowlightColor);
-
-    glPushMatrix();
-
-    // Up and forward translations.
-    glTranslatef(0.0, upMove, forwardMove);
-
-    // Torso begin.
-    if (highlight && !animateMode) if (selectedPart == 0) glColor3fv(partSelectColor);
-
-    glRotatef(partAngles[0], 1.0, 0.0, 0.0);
-
-    glPushMatrix();
-    glScalef(4.0, 16.0, 4.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Torso end.
-
-    // Head begin.
-    glPushMatrix();
-
-    glTranslatef(0.0, 11.5, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 3.0, 2.0);
-    glutWireSphere(1.0, 10, 8);
-    glPopMatrix();
-
-    glPopMatrix();
-    // Head end.
-
-    // Left upper and lower arm begin.
-    glPushMatrix();
-
-    // Left upper arm begin.
-    if (highlight && !animateMode) if (selectedPart == 1) glColor3fv(partSelectColor);
-    glTranslatef(3.0, 8.0, 0.0);
-    glRotatef(180.0 + partAngles[1], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, 4.0, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Left upper arm end.
-
-    // Left lower arm begin.
-    if (highlight && !animateMode) if (selectedPart == 2) glColor3fv(partSelectColor);
-    glTranslatef(0.0, 4.0, 0.0);
-    glRotatef(partAngles[2], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, 4.0, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Left lower arm end.
-
-    glPopMatrix();
-    // Left upper and lower arm end.
-
-    // Right upper and lower arm begin.
-    glPushMatrix();
-
-    // Right upper arm begin.
-    if (highlight && !animateMode) if (selectedPart == 3) glColor3fv(partSelectColor);
-    glTranslatef(-3.0, 8.0, 0.0);
-    glRotatef(180.0 + partAngles[3], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, 4.0, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Right upper arm end.
-
-    // Right lower arm begin.
-    if (highlight && !animateMode) if (selectedPart == 4) glColor3fv(partSelectColor);
-    glTranslatef(0.0, 4.0, 0.0);
-    glRotatef(partAngles[4], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, 4.0, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Right lower arm end.
-
-    glPopMatrix();
-    // Right upper and lower arm end.
-
-    // Left upper and lower leg with foot begin.
-    glPushMatrix();
-
-    // Left upper leg begin.
-    if (highlight && !animateMode) if (selectedPart == 5) glColor3fv(partSelectColor);
-    glTranslatef(1.5, -8.0, 0.0);
-    glRotatef(partAngles[5], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, -4.0, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Left upper leg end.
-
-    // Left lower leg with foot begin.
-    if (highlight && !animateMode) if (selectedPart == 6) glColor3fv(partSelectColor);
-    glTranslatef(0.0, -4.0, 0.0);
-    glRotatef(partAngles[6], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, -4.0, 0.0);
-
-    // Lower leg.
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-
-    // Foot.
-    glTranslatef(0.0, -5.0, 0.5);
-    glPushMatrix();
-    glScalef(2.0, 1.0, 3.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Left lower leg with foot end.
-
-    glPopMatrix();
-    // Left upper and lower leg with foot end.
-
-    // Right upper and lower leg with foot begin.
-    glPushMatrix();
-
-    // Right upper leg begin.
-    if (highlight && !animateMode) if (selectedPart == 7) glColor3fv(partSelectColor);
-    glTranslatef(-1.5, -8.0, 0.0);
-    glRotatef(partAngles[7], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, -4.0, 0.0);
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Right upper leg end.
-
-    // Right lower leg with foot begin.
-    if (highlight && !animateMode) if (selectedPart == 8) glColor3fv(partSelectColor);
-    glTranslatef(0.0, -4.0, 0.0);
-    glRotatef(partAngles[8], 1.0, 0.0, 0.0);
-    glTranslatef(0.0, -4.0, 0.0);
-
-    // Lower leg.
-    glPushMatrix();
-    glScalef(2.0, 8.0, 2.0);
-    glutWireCube(1.0);
-    glPopMatrix();
+    int i;
+    for (i = 0; i < 9; i++) partAngles[i] = values[i];
+    upMove = values[9];
+    forwardMove = values[10];
+}
 
-    // Foot.
-    glTranslatef(0.0, -5.0, 0.5);
-    glPushMatrix();
-    glScalef(2.0, 1.0, 3.0);
-    glutWireCube(1.0);
-    glPopMatrix();
+// Function to draw man: his parts posed by their angles after the up and forward
+// translations, all drawn at once (see skeleton.h).
+void Man::draw()
+{
+    float root[16] = { 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0,
+                       0.0, upMove, forwardMove, 1.0 };
+    static std::vector<float> world, colors;
+    const float *color;
+    int i, k;
 
-    if (highlight && !animateMode) glColor3fv(highlightColor);
-    // Right lower leg with foot end.
+    world.resize(16 * skeletonBones(skeleton));
+    colors.resize(3 * skeletonBones(skeleton));
+    skeletonPose(skeleton, root, partAngles, &world[0]);
 
-    glPopMatrix();
-    // Right upper and lower leg with foot end.
-
-    glPopMatrix();
+    for (i = 0; i < skeletonBones(skeleton); i++)
+    {
+        if (highlight || animateMode) color = highlightColor;
+        else color = lowlightColor;
+        if (highlight && !animateMode && skeleton.part[i] == selectedPart)
+            color = partSelectColor;
+        for (k = 0; k < 3; k++) colors[3 * i + k] = color[k];
+    }
+    skeletonDraw(skeleton, &world[0], &colors[0]);
 }
 
 // Drawing routine.
@@ -337,7 +219,22 @@ void drawScene(void)
 
     // Move man right 10 units because of data text on left of screen.
     glTranslatef(10.0, 0.0, 0.0);
-    manVectorAnimationIterator->draw();
+    if (crowdSize)
+    {
+        // Pose and draw the whole crowd.
+        crowd.update(keyframes.frames, keyframes.count, animationTime);
+        crowd.draw(highlightColor);
+    }
+    else
+    {
+        // Draw the configuration at the current time, between keyframes.
+        float pose[KEYFRAME_FLOATS];
+        Man man;
+        if (clip.count) keyframeClipPose(clip, animationTime, pose);
+        else keyframesPose(keyframes.frames, keyframes.count, animationTime, pose);
+        man.inputData(pose);
+        man.draw();
+    }
 
     // Other (fixed) objects in scene are drawn below starting here.
 
@@ -360,53 +257,48 @@ void drawScene(void)
     glTranslatef(0.0, -20.0, 10.0);
     glPushMatrix();
     glScalef(5.0, 5.0, 5.0);
-    glutWireSphere(1.0, 10, 8);
+    shapeCacheWireSphere(1.0, 10, 8);
     glPopMatrix();
 
-    glutSwapBuffers();
+    harnessSwapBuffers();
 }
 
-// Timer function.
-void animate(int value)
+// Idle function: advances the animation by the time since the last step, so it plays
+// at display rate.
+void animate(void)
 {
-    if (animateMode)
-    {
-        manVectorAnimationIterator++;
-        if (manVectorAnimationIterator == manVector.end())
-            manVectorAnimationIterator = manVector.begin();
+    int time = harnessElapsedTime();
 
-        glutPostRedisplay();
-        glutTimerFunc(animationPeriod, animate, 1);
-    }
+    animationTime += (double)(time - lastTime) / animationPeriod;
+    lastTime = time;
+    harnessPostRedisplay();
 }
 
 // Function to read configurations from file.
 void inputConfigurations(void)
 {
-    float readValue;
-    int i;
-    Man newMan;
-
-    inFile.open("animateManDataIn.txt");
+    int ok;
 
-    while (!inFile.eof())
+    if (access("animateManDataIn.clip", F_OK) == 0)
     {
-        newMan = Man();
-        for (i = 0; i < 9; i++)
+        ok = keyframeClipOpen("animateManDataIn.clip", clip);
+        if (ok && crowdSize)
         {
-            inFile >> readValue;
-            newMan.setPartAngle(readValue);
-            newMan.incrementSelectedPart();
+            // The crowd plays every part of the clip at once: decode it all.
+            keyframeClipRead(clip, keyframes);
+            keyframeClipClose(clip);
         }
-        inFile >> readValue;
-        newMan.setUpMove(readValue);
-        inFile >> readValue;
-        newMan.setForwardMove(readValue);
-        manVector.push_back(Man(newMan));
     }
-    manVector.pop_back(); // Remove configuration at the back because the routine
-                          // read eol after the last configuration and before eof and
-                          // creates a fake configuration.
+    else if (access("animateManDataIn.bin", F_OK) == 0)
+        ok = keyframesOpen("animateManDataIn.bin", keyframes);
+    else ok = keyframesReadText("animateManDataIn.txt", keyframes);
+
+    if (ok && keyframes.count == 0 && clip.count == 0)
+    {
+        std::cerr << "No configurations to animate." << std::endl;
+        ok = 0;
+    }
+    if (!ok) exit(1);
 }
 
 // Initialization routine.
@@ -414,14 +306,22 @@ void setup(void)
 {
     glClearColor(1.0, 1.0, 1.0, 0.0);
 
-    inputConfigurations(); // Read configurations from file.
+    // Build the rig of the man.
+    skeleton = skeletonMan();
 
-    // Initialize global iterators for manVector.
-    manVectorIterator = manVector.begin();
-    manVectorAnimationIterator = manVector.begin();
+    inputConfigurations(); // Read configurations from file.
 
     // Initialize camera.
     camera = Camera();
+
+    if (crowdSize)
+    {
+        // Set up the crowd and start it moving.
+        crowd.create(skeleton, crowdSize, instancing);
+        lastTime = harnessElapsedTime();
+        animateMode = 1;
+        harnessIdleFunc(animate);
+    }
 }
 
 // OpenGL window reshape routine.
@@ -430,7 +330,9 @@ void resize(int w, int h)
     glViewport(0, 0, w, h);
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    glFrustum(-5.0, 5.0, -5.0, 5.0, 5.0, 100.0);
+    // The far plane moves back to take in the rows of a crowd.
+    glFrustum(-5.0, 5.0, -5.0, 5.0, 5.0,
+              100.0 + (crowdSize ? CROWD_SPACING * sqrt(crowdSize) : 0.0));
 
     glMatrixMode(GL_MODELVIEW);
 }
@@ -446,28 +348,33 @@ void keyInput(unsigned char key, int x, int y)
     case 'a': // Toggle between animate mode on and off..
         if (animateMode == 0)
         {
-            manVectorAnimationIterator = manVector.begin();
+            animationTime = 0.0;
+            lastTime = harnessElapsedTime();
             animateMode = 1;
-            animate(1);
+            harnessIdleFunc(animate);
+        }
+        else
+        {
+            animateMode = 0;
+            harnessIdleFunc(NULL);
         }
-        else animateMode = 0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'r': // Rotate camera.
         camera.incrementViewDirection();
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'R': // Rotate camera.
         camera.decrementViewDirection();
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'z': // Zoom in.
         camera.decrementZoomDistance();
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'Z': // Zoom out.
         camera.incrementZoomDistance();
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     default:
         break;
@@ -479,7 +386,7 @@ void specialKeyInput(int key, int x, int y)
 {
     if (key == GLUT_KEY_DOWN) animationPeriod += 10;
     if (key == GLUT_KEY_UP) if (animationPeriod > 10) animationPeriod -= 10;
-    glutPostRedisplay();
+    harnessPostRedisplay();
 }
 
 // Routine to output interaction instructions to the C++ window.
@@ -492,30 +399,59 @@ void printInteraction(void)
         << "Press z/Z to zoom in/out." << std::endl;
 }
 
+// Routine to write the crowd's pose evaluation rate at exit.
+void writeCrowdStats(void)
+{
+    if (crowd.poses == 0) return;
+    std::cout << "Crowd: " << crowd.size() << " men, " << crowd.poses
+              << " poses in " << crowd.poseSeconds << " s on " << workerPoolThreads()
+              << " threads, " << crowd.posesPerSecond() << " poses evaluated per second, "
+              << (crowd.isSkinned() ? "skinned on the GPU." :
+                  crowd.isInstanced() ? "drawn instanced." : "drawn one by one.")
+              << std::endl;
+}
+
+// Routine to read the options left in argv by harnessInit().
+void readOptions(int argc, char **argv)
+{
+    int i;
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--crowd") && i + 1 < argc)
+            crowdSize = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--no-instancing"))
+            instancing = 0;
+        else if (!strcmp(argv[i], "--no-skinning"))
+            crowd.skinning = 0;
+    }
+}
+
 // Main routine.
 int main(int argc, char **argv)
 {
     printInteraction();
-    glutInit(&argc, argv);
+    harnessInit(&argc, argv);
+    readOptions(argc, argv);
+    atexit(writeCrowdStats);
 
     glutInitContextVersion(3, 1);
     glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
-    glutInitWindowSize(500, 500);
+    harnessInitWindowSize(500, 500);
     glutInitWindowPosition(100, 100);
-    glutCreateWindow("animateMan2.cpp");
+    harnessCreateWindow("animateMan2.cpp");
 
-    glutDisplayFunc(drawScene);
-    glutReshapeFunc(resize);
-    glutKeyboardFunc(keyInput);
-    glutSpecialFunc(specialKeyInput);
+    frameStatsDisplayFunc(drawScene); // Draw with frame-time telemetry.
+    harnessReshapeFunc(resize);
+    harnessKeyboardFunc(keyInput);
+    harnessSpecialFunc(specialKeyInput);
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     setup();
 
-    glutMainLoop();
+    harnessMainLoop();
 }
 
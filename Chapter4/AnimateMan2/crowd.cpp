@@ -0,0 +1,361 @@
+/////////////////////////////////////////////////////////////////////////////
+// crowd.cpp
+//
+// Implementation of the crowd declared in crowd.h.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include <GL/glew.h>
+
+#include "keyframes.h"
+#include "workerPool.h"
+#include "crowd.h"
+
+// Characters per chunk of work: 64 men's matrices are 48 KB, so a chunk's
+// output stays in cache while it is written.
+#define CHUNK 64
+
+// Most bones the skinning shader takes, and the floats of each character's
+// pose it is given.
+#define MAX_BONES 16
+#define MAX_BONES_STRING "16"
+#define POSE_FLOATS 12
+
+// Instancing vertex shader: moves the vertex by its bone's matrix, texels
+// 4 * (instance * bones + bone) to that plus 3 of the texture buffer.
+static const char *vertexShader =
+    "#version 140\n"
+    "uniform samplerBuffer boneMatrices;\n"
+    "uniform int bones;\n"
+    "uniform mat4 viewMatrix;\n"
+    "in vec3 position;\n"
+    "in int bone;\n"
+    "void main()\n"
+    "{\n"
+    "    int texel = 4 * (gl_InstanceID * bones + bone);\n"
+    "    mat4 world = mat4(texelFetch(boneMatrices, texel),\n"
+    "                      texelFetch(boneMatrices, texel + 1),\n"
+    "                      texelFetch(boneMatrices, texel + 2),\n"
+    "                      texelFetch(boneMatrices, texel + 3));\n"
+    "    gl_Position = viewMatrix * world * vec4(position, 1.0);\n"
+    "}\n";
+
+// Skinning vertex shader: poses the vertex itself. Character gl_InstanceID
+// has 12 floats, texels 3 * gl_InstanceID to that plus 2 of the texture
+// buffer: its 9 part angles, its up move, then its z and x positions, the
+// forward move included. The vertex is moved through its bone's frame and
+// each parent's in turn, just as skeletonPose() chains the matrices.
+static const char *skinningVertexShader =
+    "#version 140\n"
+    "#define MAX_BONES " MAX_BONES_STRING "\n"
+    "uniform samplerBuffer poses;\n"
+    "uniform int parent[MAX_BONES], channel[MAX_BONES];\n"
+    "uniform vec3 offset[MAX_BONES], axis[MAX_BONES], post[MAX_BONES];\n"
+    "uniform float baseAngle[MAX_BONES];\n"
+    "uniform mat4 viewMatrix;\n"
+    "in vec3 position;\n"
+    "in int bone;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 pose[3];\n"
+    "    vec3 v = position;\n"
+    "    pose[0] = texelFetch(poses, 3 * gl_InstanceID);\n"
+    "    pose[1] = texelFetch(poses, 3 * gl_InstanceID + 1);\n"
+    "    pose[2] = texelFetch(poses, 3 * gl_InstanceID + 2);\n"
+    "    for (int b = bone; b >= 0; b = parent[b])\n"
+    "    {\n"
+    "        float angle = baseAngle[b];\n"
+    "        if (channel[b] >= 0) angle += pose[channel[b] / 4][channel[b] % 4];\n"
+    "        float c = cos(radians(angle)), s = sin(radians(angle)), t = 1.0 - c;\n"
+    "        vec3 a = axis[b];\n"
+    "        mat3 rotation = mat3(a.x * a.x * t + c, a.y * a.x * t + a.z * s,\n"
+    "                             a.z * a.x * t - a.y * s,\n"
+    "                             a.x * a.y * t - a.z * s, a.y * a.y * t + c,\n"
+    "                             a.z * a.y * t + a.x * s,\n"
+    "                             a.x * a.z * t + a.y * s, a.y * a.z * t - a.x * s,\n"
+    "                             a.z * a.z * t + c);\n"
+    "        v = offset[b] + rotation * (post[b] + v);\n"
+    "    }\n"
+    "    v += vec3(pose[2].w, pose[2].y, pose[2].z);\n"
+    "    gl_Position = viewMatrix * vec4(v, 1.0);\n"
+    "}\n";
+
+static const char *fragmentShader =
+    "#version 140\n"
+    "uniform vec3 color;\n"
+    "out vec4 fragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    fragColor = vec4(color, 1.0);\n"
+    "}\n";
+
+// Vertex attribute locations.
+#define POSITION 0
+#define BONE 1
+
+// Routine to compile and link an instancing program with the vertex shader
+// source; returns 0 on failure.
+static unsigned int buildProgram(const char *source)
+{
+    const char *sources[] = { source, fragmentShader };
+    GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    unsigned int program = glCreateProgram();
+    char log[1024];
+    GLint status;
+    int k;
+
+    for (k = 0; k < 2; k++)
+    {
+        unsigned int shader = glCreateShader(types[k]);
+        glShaderSource(shader, 1, &sources[k], NULL);
+        glCompileShader(shader);
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+        if (!status)
+        {
+            glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+            std::cerr << "crowd: shader compile failed: " << log << std::endl;
+            glDeleteShader(shader);
+            glDeleteProgram(program);
+            return 0;
+        }
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+
+    glBindAttribLocation(program, POSITION, "position");
+    glBindAttribLocation(program, BONE, "bone");
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status)
+    {
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        std::cerr << "crowd: program link failed: " << log << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// Crowd constructor.
+Crowd::Crowd()
+{
+    poses = 0;
+    poseSeconds = 0.0;
+    skinning = 1;
+    skeleton = NULL;
+    instanceFloats = 0;
+    vertexBuffer = indexBuffer = 0;
+    instanceBuffer = instanceTexture = 0;
+    program = 0;
+    skinned = 0;
+    batch = 0;
+}
+
+// Routine to set up a crowd of count characters rigged by rig, which must
+// outlive the crowd: lays them out in a square grid running back from the
+// origin, character 0 at the origin, gives each a phase and, if allowed and
+// supported, builds the buffers and program for instanced drawing, skinned
+// if skinning is set and the rig is small enough.
+void Crowd::create(const Skeleton &rig, int count, int allowInstancing)
+{
+    int side = ceil(sqrt((double)count)), c;
+    size_t vertices = rig.vertexBone.size();
+    GLint maxTexels;
+
+    skeleton = &rig;
+    positionX.resize(count);
+    positionZ.resize(count);
+    phase.resize(count);
+    for (c = 0; c < count; c++)
+    {
+        positionX[c] = (c % side - side / 2) * CROWD_SPACING;
+        positionZ[c] = -(c / side) * CROWD_SPACING;
+        // Golden ratio steps spread the phases evenly over the loop.
+        phase[c] = fmod(c * 0.6180339887, 1.0);
+    }
+    instanceFloats = 16 * skeletonBones(rig);
+
+    if (allowInstancing && GLEW_VERSION_3_1 && vertices && !program)
+    {
+        if (skinning && skeletonBones(rig) <= MAX_BONES)
+            program = buildProgram(skinningVertexShader);
+        if (program)
+        {
+            skinned = 1;
+            instanceFloats = POSE_FLOATS;
+        }
+        else program = buildProgram(vertexShader);
+    }
+    instanceData.resize((size_t)instanceFloats * count);
+    if (!program) return;
+
+    // Vertex buffer: the positions of the man's lines, then their bones.
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices * (3 * sizeof(float) + sizeof(int)),
+                 NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, 3 * vertices * sizeof(float),
+                    &rig.positions[0]);
+    glBufferSubData(GL_ARRAY_BUFFER, 3 * vertices * sizeof(float),
+                    vertices * sizeof(int), &rig.vertexBone[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, rig.lines.size() * sizeof(unsigned int),
+                 &rig.lines[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // Texture buffer of instance data, filled each frame; it may be too small
+    // for the whole crowd, which is then drawn in batches.
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    batch = std::min(count, maxTexels / (instanceFloats / 4));
+    glGenBuffers(1, &instanceBuffer);
+    glGenTextures(1, &instanceTexture);
+    glBindBuffer(GL_TEXTURE_BUFFER, instanceBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * instanceFloats * batch, NULL,
+                 GL_STREAM_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, instanceBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Routine to evaluate every character's pose at time (in frames) of the
+// frameCount keyframes frames, in parallel, and, unless skinned, its bone
+// matrices.
+void Crowd::update(const float *frames, size_t frameCount, double time)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    workerPoolFor(size(), CHUNK, [&](size_t first, size_t last)
+    {
+        float pose[KEYFRAME_FLOATS];
+        float root[16] = { 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0,
+                           0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0 };
+        size_t c;
+
+        for (c = first; c < last; c++)
+        {
+            float *data = &instanceData[(size_t)instanceFloats * c];
+
+            keyframesPose(frames, frameCount, time + phase[c] * frameCount, pose);
+            if (skinned)
+            {
+                // The skinning shader's layout, see above.
+                std::copy(pose, pose + 10, data);
+                data[10] = positionZ[c] + pose[10];
+                data[11] = positionX[c];
+                continue;
+            }
+            root[12] = positionX[c];
+            root[13] = pose[9];
+            root[14] = positionZ[c] + pose[10];
+            skeletonPose(*skeleton, root, pose, data);
+        }
+    });
+
+    poses += size();
+    poseSeconds += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+// Routine to return the poses evaluated per second of update().
+double Crowd::posesPerSecond() const
+{
+    return poseSeconds > 0.0 ? poses / poseSeconds : 0.0;
+}
+
+// Routine to draw the crowd as posed by the last update(), in color.
+void Crowd::draw(const float color[3])
+{
+    std::vector<float> colors;
+    int bones = skeletonBones(*skeleton), c;
+
+    if (program)
+    {
+        drawInstanced(color);
+        return;
+    }
+
+    for (c = 0; c < 3 * bones; c++) colors.push_back(color[c % 3]);
+    for (c = 0; c < size(); c++)
+        skeletonDraw(*skeleton, &instanceData[(size_t)instanceFloats * c],
+                     &colors[0]);
+}
+
+// Routine to draw the crowd with one instanced call per batch of characters
+// the texture buffer holds.
+void Crowd::drawInstanced(const float color[3])
+{
+    int bones = skeletonBones(*skeleton), first, count;
+    size_t vertices = skeleton->vertexBone.size();
+    float modelview[16], projection[16], view[16];
+    int i, j;
+
+    // The shader takes projection * modelview in one matrix.
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    for (j = 0; j < 4; j++)
+        for (i = 0; i < 4; i++)
+            view[4 * j + i] = projection[i] * modelview[4 * j] +
+                              projection[4 + i] * modelview[4 * j + 1] +
+                              projection[8 + i] * modelview[4 * j + 2] +
+                              projection[12 + i] * modelview[4 * j + 3];
+
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "viewMatrix"), 1, GL_FALSE,
+                       view);
+    glUniform3fv(glGetUniformLocation(program, "color"), 1, color);
+    if (skinned)
+    {
+        const Skeleton &rig = *skeleton;
+        glUniform1i(glGetUniformLocation(program, "poses"), 0);
+        glUniform1iv(glGetUniformLocation(program, "parent"), bones, &rig.parent[0]);
+        glUniform1iv(glGetUniformLocation(program, "channel"), bones,
+                     &rig.channel[0]);
+        glUniform3fv(glGetUniformLocation(program, "offset"), bones, &rig.offset[0]);
+        glUniform3fv(glGetUniformLocation(program, "axis"), bones, &rig.axis[0]);
+        glUniform3fv(glGetUniformLocation(program, "post"), bones, &rig.post[0]);
+        glUniform1fv(glGetUniformLocation(program, "baseAngle"), bones,
+                     &rig.baseAngle[0]);
+    }
+    else
+    {
+        glUniform1i(glGetUniformLocation(program, "bones"), bones);
+        glUniform1i(glGetUniformLocation(program, "boneMatrices"), 0);
+    }
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glVertexAttribPointer(POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glVertexAttribIPointer(BONE, 1, GL_INT, 0,
+                           (void *)(3 * vertices * sizeof(float)));
+    glEnableVertexAttribArray(POSITION);
+    glEnableVertexAttribArray(BONE);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+    glBindBuffer(GL_TEXTURE_BUFFER, instanceBuffer);
+
+    for (first = 0; first < size(); first += batch)
+    {
+        count = std::min(batch, size() - first);
+        // Orphan the last batch's storage rather than wait for its draw.
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * instanceFloats * batch, NULL,
+                     GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(float) * instanceFloats * count,
+                        &instanceData[(size_t)instanceFloats * first]);
+        glDrawElementsInstanced(GL_LINES, skeleton->lines.size(), GL_UNSIGNED_INT,
+                                0, count);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glPopClientAttrib(); // Also restores the buffer bindings.
+    glUseProgram(0);
+}
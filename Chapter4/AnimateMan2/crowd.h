@@ -0,0 +1,76 @@
+/////////////////////////////////////////////////////////////////////////////
+// crowd.h
+//
+// A crowd of men for animateMan2.cpp, all playing the same keyframes, each
+// at its own phase, stored structure-of-arrays: one array each of x, z and
+// phase, indexed by character.
+//
+// update() evaluates every character's pose and bone matrices (see
+// skeleton.h) in parallel on the worker pool (see workerPool.h), in chunks
+// of neighbouring characters, writing each character's matrices contiguously
+// into one array.
+//
+// Where texture buffers and instanced draws are available (OpenGL 3.1) the
+// array is copied into a texture buffer and the whole crowd is drawn with
+// one instanced call: the lines of the man are in a static vertex buffer,
+// each vertex tagged with its bone, and the vertex shader fetches the
+// matrix of that bone of instance gl_InstanceID. Otherwise each character is
+// drawn in turn with skeletonDraw().
+//
+// Better still, the instanced draw can skin the man on the GPU: the vertex
+// shader, given the rig as uniform arrays, turns each vertex through its
+// bone and the bone's parents itself. update() then only evaluates the
+// keyframes and each character uploads 12 floats, its pose and position,
+// in place of 16 for each of its bones.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef CROWD_H
+#define CROWD_H
+
+#include <cstddef>
+#include <vector>
+
+#include "skeleton.h"
+
+// Distance between neighbouring characters.
+#define CROWD_SPACING 12.0
+
+class Crowd
+{
+public:
+    Crowd();
+    void create(const Skeleton &rig, int count, int allowInstancing);
+    int size() const { return positionX.size(); }
+    void update(const float *frames, size_t frameCount, double time);
+    void draw(const float color[3]);
+    int isInstanced() const { return program != 0; }
+    int isSkinned() const { return skinned; }
+    double posesPerSecond() const;
+
+    // Poses evaluated by update() and the seconds it took, accumulated.
+    unsigned long poses;
+    double poseSeconds;
+    // Skin the instanced crowd on the GPU if supported? On by default.
+    int skinning;
+
+private:
+    void drawInstanced(const float color[3]);
+
+    const Skeleton *skeleton;
+
+    // Per-character data.
+    std::vector<float> positionX, positionZ, phase;
+
+    // Instance data of each character in turn: its bone matrices or, skinned,
+    // its pose.
+    std::vector<float> instanceData;
+    int instanceFloats; // Floats of instance data per character.
+    unsigned int vertexBuffer; // Positions then bones of the man's lines.
+    unsigned int indexBuffer;
+    unsigned int instanceBuffer, instanceTexture; // Texture buffer of the above.
+    unsigned int program; // Instancing program id, 0 if not instanced.
+    int skinned; // Is program the skinning program?
+    int batch; // Most characters the texture buffer holds.
+};
+
+#endif
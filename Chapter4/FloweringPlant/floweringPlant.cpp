@@ -22,6 +22,9 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 
+#include "harness.h"
+#include "mesh.h"
+
 // Globals.
 static float t = 0.0; // Animation parameter.
 // Angles to rotate scene.
@@ -29,31 +32,7 @@ static float Xangle = 0.0, Yangle = 260.0, Zangle = 0.0;
 static int isAnimate = 0; // Animated?
 static int animationPeriod = 100; // Time interval between frames.
 static unsigned int base; // Display lists base index.
-
-// Routine to draw hemisphere.
-void drawHemisphere(float radius, int longSlices, int latSlices)
-{
-    int  i, j;
-    for (j = 0; j < latSlices; j++)
-    {
-        // One latitudinal triangle strip.
-        glBegin(GL_TRIANGLE_STRIP);
-        for (i = 0; i <= longSlices; i++)
-        {
-            glVertex3f(radius * cos((float)(j + 1) / latSlices * M_PI / 2.0)
-                       * cos(2.0 * (float)i / longSlices * M_PI),
-                radius * sin((float)(j + 1) / latSlices * M_PI / 2.0),
-                -radius * cos((float)(j + 1) / latSlices * M_PI / 2.0)
-                       * sin(2.0 * (float)i / longSlices * M_PI));
-            glVertex3f(radius * cos((float)j / latSlices * M_PI / 2.0)
-                       * cos(2.0 * (float)i / longSlices * M_PI),
-                radius * sin((float)j / latSlices * M_PI / 2.0),
-                -radius * cos((float)j / latSlices * M_PI / 2.0)
-                       * sin(2.0 * (float)i / longSlices * M_PI));
-        }
-        glEnd();
-    }
-}
+static Mesh sepal; // Hemisphere of the sepal.
 
 // Routine to draw circle.
 void drawCircle(float radius, int numVertices)
@@ -75,6 +54,8 @@ void setup(void)
     glClearColor(1.0, 1.0, 1.0, 0.0);
     glEnable(GL_DEPTH_TEST); // Enable depth testing.
 
+    sepal = meshHemisphere(2.0, 6, 6);
+
     base = glGenLists(3);
     glListBase(base);
 
@@ -126,7 +107,7 @@ void drawScene(void)
 
     // Hemisphere is scaled to be ellipsoidal.
     glScalef(hemisphereScaleFactor, 1.0, hemisphereScaleFactor);    
-    drawHemisphere(2.0, 6, 6);
+    meshDraw(sepal);
 
     glPopMatrix();
     glEndList();
@@ -216,7 +197,7 @@ void drawScene(void)
     glCallList(base + 2);
     glPopMatrix();
 
-    glutSwapBuffers();
+    harnessSwapBuffers();
 }
 
 // Timer function.
@@ -228,8 +209,8 @@ void animate(int value)
         if (t >= 1.0)
             isAnimate = 0;
 
-        glutPostRedisplay();
-        glutTimerFunc(animationPeriod, animate, 1);
+        harnessPostRedisplay();
+        harnessTimerFunc(animationPeriod, animate, 1);
     }
 }
 
@@ -265,43 +246,43 @@ void keyInput(unsigned char key, int x, int y)
         if (isAnimate)
             isAnimate = 0;
         t = 0.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'x':
         Xangle += 5.0;
         if (Xangle > 360.0)
             Xangle -= 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'X':
         Xangle -= 5.0;
         if (Xangle < 0.0)
             Xangle += 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'y':
         Yangle += 5.0;
         if (Yangle > 360.0)
             Yangle -= 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'Y':
         Yangle -= 5.0;
         if (Yangle < 0.0)
             Yangle += 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'z':
         Zangle += 5.0;
         if (Zangle > 360.0)
             Zangle -= 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'Z':
         Zangle -= 5.0;
         if (Zangle < 0.0)
             Zangle += 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     default:
         break;
@@ -323,24 +304,24 @@ void printInteraction(void)
 int main(int argc, char **argv)
 {
     printInteraction();
-    glutInit(&argc, argv);
+    harnessInit(&argc, argv);
 
     glutInitContextVersion(3, 1);
     glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
-    glutInitWindowSize(500, 500);
+    harnessInitWindowSize(500, 500);
     glutInitWindowPosition(100, 100);
-    glutCreateWindow("floweringPlant.cpp");
-    glutDisplayFunc(drawScene);
-    glutReshapeFunc(resize);
-    glutKeyboardFunc(keyInput);
+    harnessCreateWindow("floweringPlant.cpp");
+    harnessDisplayFunc(drawScene);
+    harnessReshapeFunc(resize);
+    harnessKeyboardFunc(keyInput);
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     setup();
 
-    glutMainLoop();
+    harnessMainLoop();
 }
 
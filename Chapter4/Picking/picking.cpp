@@ -15,6 +15,8 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 
+#include "harness.h"
+
 // Globals.
 static unsigned int 
 isSelecting = 0, // In selection mode?
@@ -88,7 +90,7 @@ void drawScene(void)
     }
     glEnd();
 
-    glutSwapBuffers();
+    harnessSwapBuffers();
 }
 
 // Process hit buffer to find record with smallest min-z value.
@@ -156,7 +158,7 @@ void pickFunction(int button, int state, int x, int y)
 
     // Draw triangles without name loading, clicked one will be highlighted.
     isSelecting = 0;
-    glutPostRedisplay();
+    harnessPostRedisplay();
 }
 
 // Initialization routine.
@@ -201,25 +203,25 @@ void printInteraction(void)
 int main(int argc, char **argv)
 {
     printInteraction();
-    glutInit(&argc, argv);
+    harnessInit(&argc, argv);
 
     glutInitContextVersion(3, 1);
     glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
-    glutInitWindowSize(500, 500);
+    harnessInitWindowSize(500, 500);
     glutInitWindowPosition(100, 100);
-    glutCreateWindow("picking.cpp");
-    glutDisplayFunc(drawScene);
-    glutReshapeFunc(resize);
-    glutKeyboardFunc(keyInput);
-    glutMouseFunc(pickFunction);
+    harnessCreateWindow("picking.cpp");
+    harnessDisplayFunc(drawScene);
+    harnessReshapeFunc(resize);
+    harnessKeyboardFunc(keyInput);
+    harnessMouseFunc(pickFunction);
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     setup();
 
-    glutMainLoop();
+    harnessMainLoop();
 }
 
@@ -1,9 +1,9 @@
 ////////////////////////////////////////////////////////////////
 // rotatingHelixFPS.cpp
 //
-// This program enhances rotatingHelix2.cpp to add a routine to
-// count and output the number of frames drawn per second to
-// the debug window.
+// This program enhances rotatingHelix2.cpp to record the time
+// taken by every frame and output its percentiles each second
+// to the debug window (see Common/frameStats.h).
 //
 // Interaction:
 // Press space to toggle between animation on and off.
@@ -20,12 +20,14 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 
+#include "harness.h"
+#include "frameStats.h"
+
 using namespace std;
 
 // Globals.
 static int isAnimate = 0; // Animated?
 static float angle = 0.0; // Angle of rotation.
-static int frameCount = 0; // Number of frames
 
 // Drawing routine.
 void drawScene(void)
@@ -34,8 +36,6 @@ void drawScene(void)
 
    float t; // Angle parameter along helix.
 
-   frameCount++; // Increment number of frames every redraw.
-
    glClear(GL_COLOR_BUFFER_BIT);
    glColor3f(0.0, 0.0, 0.0);
    glPushMatrix();
@@ -52,7 +52,7 @@ void drawScene(void)
    glEnd();
    
    glPopMatrix();
-   glutSwapBuffers();
+   harnessSwapBuffers();
 }
 
 // Initialization routine.
@@ -78,17 +78,7 @@ void increaseAngle(void)
    angle += 5.0;
    if (angle > 360.0)
        angle -= 360.0;
-   glutPostRedisplay();
-}
-
-// Routine to count the number of frames drawn every second.
-void frameCounter(int value)
-{
-   // No output the first time frameCounter() is called (from main()).
-   if (value != 0)
-      cout << "FPS = " << frameCount << endl;
-   frameCount = 0;
-   glutTimerFunc(1000, frameCounter, 1);
+   harnessPostRedisplay();
 }
 
 // Keyboard input processing routine.
@@ -103,12 +93,12 @@ void keyInput(unsigned char key, int x, int y)
          if(isAnimate) 
          {
             isAnimate = 0;
-            glutIdleFunc(NULL);
+            harnessIdleFunc(NULL);
          }
          else 
          {
             isAnimate = 1;
-            glutIdleFunc(increaseAngle);
+            harnessIdleFunc(increaseAngle);
          }
          break;
       default:
@@ -127,24 +117,23 @@ void printInteraction(void)
 int main(int argc, char **argv) 
 {
    printInteraction();
-   glutInit(&argc, argv);
+   harnessInit(&argc, argv);
 
    glutInitContextVersion(3, 1);
    glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE); 
 
    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA); 
-   glutInitWindowSize(500, 500);
+   harnessInitWindowSize(500, 500);
    glutInitWindowPosition(100, 100); 
-   glutCreateWindow("rotatingHelixFPS.cpp");
-   glutDisplayFunc(drawScene); 
-   glutReshapeFunc(resize);  
-   glutKeyboardFunc(keyInput);
-   glutTimerFunc(0, frameCounter, 0); // Initial call of frameCounter().
+   harnessCreateWindow("rotatingHelixFPS.cpp");
+   frameStatsDisplayFunc(drawScene); // Draw with frame-time telemetry.
+   harnessReshapeFunc(resize);  
+   harnessKeyboardFunc(keyInput);
 
    glewExperimental = GL_TRUE; 
    glewInit(); 
    
    setup(); 
 
-   glutMainLoop(); 
+   harnessMainLoop(); 
 }
@@ -0,0 +1,540 @@
+/////////////////////////////////////////////////////////////////////////////
+// asteroidField.cpp
+//
+// Implementation of the asteroid field declared in asteroidField.h.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <GL/glew.h>
+
+#include "shapeCache.h"
+#include "asteroidField.h"
+
+// Instancing vertex shader: places the unit sphere vertex at the asteroid.
+static const char *vertexShader =
+    "#version 130\n"
+    "in float centerX, centerY, centerZ, radius;\n"
+    "in vec3 color;\n"
+    "out vec3 asteroidColor;\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 position = vec3(centerX, centerY, centerZ) + radius * gl_Vertex.xyz;\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 1.0);\n"
+    "    asteroidColor = color;\n"
+    "}\n";
+
+static const char *fragmentShader =
+    "#version 130\n"
+    "in vec3 asteroidColor;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = vec4(asteroidColor, 1.0);\n"
+    "}\n";
+
+// Multi-view vertex shader: as above, but leaves the vertex in world
+// coordinates for the geometry shader to project once per view.
+static const char *multiViewVertexShader =
+    "#version 150 compatibility\n"
+    "in float centerX, centerY, centerZ, radius;\n"
+    "in vec3 color;\n"
+    "out vec4 worldPosition;\n"
+    "out vec3 vertexColor;\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 position = vec3(centerX, centerY, centerZ) + radius * gl_Vertex.xyz;\n"
+    "    worldPosition = vec4(position, 1.0);\n"
+    "    vertexColor = color;\n"
+    "}\n";
+
+// Multi-view geometry shader: invocation k emits the line into viewport k
+// through view k's projection * modelview.
+static const char *multiViewGeometryShader =
+    "#version 150 compatibility\n"
+    "#extension GL_ARB_gpu_shader5 : require\n"
+    "#extension GL_ARB_viewport_array : require\n"
+    "layout(lines, invocations = 2) in;\n"
+    "layout(line_strip, max_vertices = 2) out;\n"
+    "uniform mat4 viewMatrices[2];\n"
+    "in vec4 worldPosition[];\n"
+    "in vec3 vertexColor[];\n"
+    "out vec3 asteroidColor;\n"
+    "void main()\n"
+    "{\n"
+    "    for (int k = 0; k < 2; k++)\n"
+    "    {\n"
+    "        gl_Position = viewMatrices[gl_InvocationID] * worldPosition[k];\n"
+    "        gl_ViewportIndex = gl_InvocationID;\n"
+    "        asteroidColor = vertexColor[k];\n"
+    "        EmitVertex();\n"
+    "    }\n"
+    "    EndPrimitive();\n"
+    "}\n";
+
+// Per-instance attributes, bound to locations 1 to 5 in both programs
+// (location 0 is gl_Vertex).
+static const char *attributeNames[] =
+    { "centerX", "centerY", "centerZ", "radius", "color" };
+#define ATTRIBUTE(k) ((k) + 1)
+
+// Routine to return the sphere tessellation glutWireSphere() was called with.
+static int slicesOf(float radius)
+{
+    return (int)radius * 6;
+}
+
+// Routine to compile and link a program from count shaders; returns 0 on
+// failure.
+static unsigned int buildProgram(const char **sources, const GLenum *types,
+                                 int count)
+{
+    unsigned int program = glCreateProgram();
+    char log[1024];
+    GLint status;
+    int k;
+
+    for (k = 0; k < count; k++)
+    {
+        unsigned int shader = glCreateShader(types[k]);
+        glShaderSource(shader, 1, &sources[k], NULL);
+        glCompileShader(shader);
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+        if (!status)
+        {
+            glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+            std::cerr << "asteroidField: shader compile failed: " << log
+                      << std::endl;
+            glDeleteShader(shader);
+            glDeleteProgram(program);
+            return 0;
+        }
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+
+    for (k = 0; k < 5; k++)
+        glBindAttribLocation(program, ATTRIBUTE(k), attributeNames[k]);
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status)
+    {
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        std::cerr << "asteroidField: program link failed: " << log << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// Routine to record the current viewport and projection * modelview in view.
+void captureView(View &view)
+{
+    float modelview[16], projection[16];
+    int i, j, k;
+
+    glGetIntegerv(GL_VIEWPORT, view.viewport);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    // Column-major product.
+    for (j = 0; j < 4; j++)
+        for (i = 0; i < 4; i++)
+        {
+            view.matrix[4 * j + i] = 0.0;
+            for (k = 0; k < 4; k++)
+                view.matrix[4 * j + i] +=
+                    projection[4 * k + i] * modelview[4 * j + k];
+        }
+}
+
+AsteroidField::AsteroidField()
+{
+    instanceBuffer = streamBuffer = 0;
+    program = multiViewProgram = 0;
+    culling = 1;
+    multiView = 0;
+    cellsX = cellsZ = 0;
+}
+
+// Routine to add an asteroid.
+void AsteroidField::add(float x, float y, float z, float r,
+                        unsigned char colorR, unsigned char colorG,
+                        unsigned char colorB)
+{
+    centerX.push_back(x);
+    centerY.push_back(y);
+    centerZ.push_back(z);
+    radius.push_back(r);
+    color.push_back(colorR);
+    color.push_back(colorG);
+    color.push_back(colorB);
+}
+
+// Routine to reorder the asteroids so that those sharing a tessellation are
+// contiguous, recording each run in groups.
+void AsteroidField::sortByTessellation()
+{
+    std::vector<int> order(size());
+    std::vector<float> x(size()), y(size()), z(size()), r(size());
+    std::vector<unsigned char> c(3 * size());
+    int i, k;
+
+    for (i = 0; i < size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [this](int a, int b)
+                     { return slicesOf(radius[a]) < slicesOf(radius[b]); });
+
+    for (i = 0; i < size(); i++)
+    {
+        x[i] = centerX[order[i]];
+        y[i] = centerY[order[i]];
+        z[i] = centerZ[order[i]];
+        r[i] = radius[order[i]];
+        for (k = 0; k < 3; k++) c[3 * i + k] = color[3 * order[i] + k];
+    }
+    centerX.swap(x);
+    centerY.swap(y);
+    centerZ.swap(z);
+    radius.swap(r);
+    color.swap(c);
+
+    groups.clear();
+    for (i = 0; i < size(); i++)
+    {
+        int slices = slicesOf(radius[i]);
+        if (groups.empty() || groups.back().slices != slices)
+        {
+            Group group = { i, 0, slices };
+            groups.push_back(group);
+        }
+        groups.back().count++;
+    }
+}
+
+// Routine to bucket the asteroids into the collision grid by counting sort.
+void AsteroidField::buildGrid()
+{
+    float maxX, maxZ, area;
+    std::vector<int> next;
+    int i, c;
+
+    cellsX = cellsZ = 0;
+    if (size() == 0) return;
+
+    gridX = maxX = centerX[0];
+    gridZ = maxZ = centerZ[0];
+    maxRadius = 0.0;
+    for (i = 0; i < size(); i++)
+    {
+        gridX = std::min(gridX, centerX[i]);
+        maxX = std::max(maxX, centerX[i]);
+        gridZ = std::min(gridZ, centerZ[i]);
+        maxZ = std::max(maxZ, centerZ[i]);
+        maxRadius = std::max(maxRadius, radius[i]);
+    }
+
+    // About one asteroid per cell, but no smaller than an asteroid.
+    area = (maxX - gridX) * (maxZ - gridZ);
+    cellSize = std::max(2.0f * maxRadius, (float)sqrt(area / size()));
+    if (cellSize <= 0.0) cellSize = 1.0;
+    cellsX = (int)((maxX - gridX) / cellSize) + 1;
+    cellsZ = (int)((maxZ - gridZ) / cellSize) + 1;
+
+    cellStart.assign(cellsX * cellsZ + 1, 0);
+    for (i = 0; i < size(); i++)
+    {
+        c = (int)((centerZ[i] - gridZ) / cellSize) * cellsX +
+            (int)((centerX[i] - gridX) / cellSize);
+        cellStart[c + 1]++;
+    }
+    for (c = 0; c < cellsX * cellsZ; c++) cellStart[c + 1] += cellStart[c];
+
+    next.assign(cellStart.begin(), cellStart.end() - 1);
+    cellAsteroids.resize(size());
+    for (i = 0; i < size(); i++)
+    {
+        c = (int)((centerZ[i] - gridZ) / cellSize) * cellsX +
+            (int)((centerX[i] - gridX) / cellSize);
+        cellAsteroids[next[c]++] = i;
+    }
+}
+
+// Routine to check if the sphere centered at (x, y, z) with radius r
+// intersects an asteroid. Only the cells within r plus the largest asteroid
+// radius of the center are searched.
+int AsteroidField::intersectsSphere(float x, float y, float z, float r) const
+{
+    float reach = r + maxRadius;
+    int i, k, i0, i1, k0, k1, c, a, j;
+
+    if (cellsX == 0) return 0;
+
+    i0 = std::max((int)floor((x - reach - gridX) / cellSize), 0);
+    i1 = std::min((int)floor((x + reach - gridX) / cellSize), cellsX - 1);
+    k0 = std::max((int)floor((z - reach - gridZ) / cellSize), 0);
+    k1 = std::min((int)floor((z + reach - gridZ) / cellSize), cellsZ - 1);
+
+    for (k = k0; k <= k1; k++)
+        for (i = i0; i <= i1; i++)
+        {
+            c = k * cellsX + i;
+            for (j = cellStart[c]; j < cellStart[c + 1]; j++)
+            {
+                a = cellAsteroids[j];
+                float dx = x - centerX[a], dy = y - centerY[a], dz = z - centerZ[a];
+                if (dx * dx + dy * dy + dz * dz <=
+                    (r + radius[a]) * (r + radius[a]))
+                    return 1;
+            }
+        }
+    return 0;
+}
+
+// Routine to prepare the field for drawing once all asteroids are added:
+// groups the asteroids by tessellation, builds the collision grid and, if
+// allowed and supported, fills the instance buffer. Call again after
+// changing the field.
+void AsteroidField::upload(int allowInstancing)
+{
+    size_t n = size(), floats = n * sizeof(float);
+
+    sortByTessellation();
+    buildGrid();
+
+    if (allowInstancing && !program &&
+        (GLEW_VERSION_3_3 || GLEW_ARB_instanced_arrays))
+    {
+        const char *sources[] = { vertexShader, fragmentShader };
+        GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+        program = buildProgram(sources, types, 2);
+    }
+    if (program && multiView && !multiViewProgram &&
+        GLEW_ARB_viewport_array && GLEW_ARB_gpu_shader5)
+    {
+        const char *sources[] = { multiViewVertexShader,
+                                  multiViewGeometryShader, fragmentShader };
+        GLenum types[] =
+            { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+        multiViewProgram = buildProgram(sources, types, 3);
+    }
+    if (!program || n == 0) return;
+
+    // Instance buffer: the x, y, z, radius and color arrays back to back.
+    if (!instanceBuffer) glGenBuffers(1, &instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, 4 * floats + 3 * n, NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, floats, &centerX[0]);
+    glBufferSubData(GL_ARRAY_BUFFER, floats, floats, &centerY[0]);
+    glBufferSubData(GL_ARRAY_BUFFER, 2 * floats, floats, &centerZ[0]);
+    glBufferSubData(GL_ARRAY_BUFFER, 3 * floats, floats, &radius[0]);
+    glBufferSubData(GL_ARRAY_BUFFER, 4 * floats, 3 * n, &color[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Routine to find the asteroids whose bounding spheres are at least partly
+// inside the view frustum of the projection * modelview m, or all of them
+// with culling off, in index order.
+void AsteroidField::cull(const float m[16], std::vector<int> &inFrustum) const
+{
+    float planes[6][4], length;
+    int n = size(), i, k, p;
+
+    inFrustum.clear();
+    if (!culling)
+    {
+        for (i = 0; i < n; i++) inFrustum.push_back(i);
+        return;
+    }
+
+    // Left, right, bottom, top, near and far planes: row 3 of m plus or
+    // minus row 0, 1 or 2, scaled so that they give true distances.
+    for (p = 0; p < 6; p++)
+    {
+        for (k = 0; k < 4; k++)
+            planes[p][k] = m[4 * k + 3] + (p % 2 ? -1.0 : 1.0) * m[4 * k + p / 2];
+        length = sqrt(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] +
+                      planes[p][2] * planes[p][2]);
+        for (k = 0; k < 4; k++) planes[p][k] /= length;
+    }
+
+    i = 0;
+#ifdef __SSE2__
+    // Four asteroids at a time straight from the coordinate arrays.
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&centerX[i]);
+        __m128 y = _mm_loadu_ps(&centerY[i]);
+        __m128 z = _mm_loadu_ps(&centerZ[i]);
+        __m128 minusR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[i]));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        int mask;
+
+        for (p = 0; p < 6; p++)
+        {
+            __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(planes[p][0])),
+                           _mm_mul_ps(y, _mm_set1_ps(planes[p][1]))),
+                _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(planes[p][2])),
+                           _mm_set1_ps(planes[p][3])));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, minusR));
+        }
+        mask = _mm_movemask_ps(inside);
+        for (k = 0; k < 4; k++)
+            if (mask & (1 << k)) inFrustum.push_back(i + k);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        for (p = 0; p < 6; p++)
+            if (planes[p][0] * centerX[i] + planes[p][1] * centerY[i] +
+                planes[p][2] * centerZ[i] + planes[p][3] < -radius[i])
+                break;
+        if (p == 6) inFrustum.push_back(i);
+    }
+}
+
+// Routine to draw the field with the current modelview and projection,
+// adding the numbers of asteroids drawn and culled to stats.
+void AsteroidField::draw(CullStats &stats)
+{
+    View view;
+
+    captureView(view);
+    cull(view.matrix, visible);
+    stats.frames++;
+    stats.drawn += visible.size();
+    stats.culled += size() - visible.size();
+
+    if (program) drawInstanced(program);
+    else drawEach();
+}
+
+// Routine to draw the field into both views with one submission, adding the
+// numbers of asteroids inside each view's frustum and outside it to
+// stats[0] and stats[1]. Requires isMultiView(). The asteroids inside either
+// frustum are drawn once, the geometry shader emitting each line into both
+// viewports, where clipping discards what lies outside the view.
+void AsteroidField::drawViews(const View views[2], CullStats stats[2])
+{
+    std::vector<int> inView[2];
+    float matrices[2][16];
+    GLint viewport[4];
+    int k;
+
+    for (k = 0; k < 2; k++)
+    {
+        cull(views[k].matrix, inView[k]);
+        stats[k].frames++;
+        stats[k].drawn += inView[k].size();
+        stats[k].culled += size() - inView[k].size();
+        std::copy(views[k].matrix, views[k].matrix + 16, matrices[k]);
+    }
+    visible.clear();
+    std::set_union(inView[0].begin(), inView[0].end(), inView[1].begin(),
+                   inView[1].end(), std::back_inserter(visible));
+
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    for (k = 0; k < 2; k++)
+        glViewportIndexedf(k, views[k].viewport[0], views[k].viewport[1],
+                           views[k].viewport[2], views[k].viewport[3]);
+    glUseProgram(multiViewProgram);
+    glUniformMatrix4fv(glGetUniformLocation(multiViewProgram, "viewMatrices"),
+                       2, GL_FALSE, &matrices[0][0]);
+    drawInstanced(multiViewProgram);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// Routine to draw each group of the visible asteroids with one instanced
+// call of the program shaders. If any are culled, their data is first gathered into the stream
+// buffer, laid out like the instance buffer.
+void AsteroidField::drawInstanced(unsigned int shaders)
+{
+    size_t n = visible.size(), floats = n * sizeof(float);
+    std::vector<Group> runs; // Groups of the visible asteroids.
+    std::vector<Group>::iterator run;
+    size_t v;
+    int k;
+
+    if (n == 0) return;
+
+    if ((int)n == size())
+    {
+        runs = groups;
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    }
+    else
+    {
+        std::vector<char> data(4 * floats + 3 * n);
+        float *x = (float *)&data[0], *y = x + n, *z = y + n, *r = z + n;
+        unsigned char *c = (unsigned char *)(r + n);
+
+        for (v = 0; v < n; v++)
+        {
+            int i = visible[v], slices = slicesOf(radius[i]);
+            x[v] = centerX[i];
+            y[v] = centerY[i];
+            z[v] = centerZ[i];
+            r[v] = radius[i];
+            for (k = 0; k < 3; k++) c[3 * v + k] = color[3 * i + k];
+            if (runs.empty() || runs.back().slices != slices)
+            {
+                Group run = { (int)v, 0, slices };
+                runs.push_back(run);
+            }
+            runs.back().count++;
+        }
+
+        if (!streamBuffer) glGenBuffers(1, &streamBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+        glBufferData(GL_ARRAY_BUFFER, data.size(), &data[0], GL_STREAM_DRAW);
+    }
+
+    glUseProgram(shaders);
+    for (k = 0; k < 5; k++)
+    {
+        glEnableVertexAttribArray(ATTRIBUTE(k));
+        glVertexAttribDivisor(ATTRIBUTE(k), 1);
+    }
+
+    for (run = runs.begin(); run != runs.end(); run++)
+    {
+        if (run->slices < 1) continue; // Too small to be drawn.
+        for (k = 0; k < 4; k++)
+            glVertexAttribPointer(ATTRIBUTE(k), 1, GL_FLOAT, GL_FALSE, 0,
+                                  (const void *)(k * floats +
+                                                 run->first * sizeof(float)));
+        glVertexAttribPointer(ATTRIBUTE(4), 3, GL_UNSIGNED_BYTE, GL_TRUE, 0,
+                              (const void *)(4 * floats + 3 * run->first));
+        meshDrawInstanced(shapeCacheWireSphereMesh(run->slices, run->slices),
+                          run->count);
+    }
+
+    for (k = 0; k < 5; k++)
+    {
+        glVertexAttribDivisor(ATTRIBUTE(k), 0);
+        glDisableVertexAttribArray(ATTRIBUTE(k));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+}
+
+// Routine to draw the visible asteroids one at a time.
+void AsteroidField::drawEach()
+{
+    std::vector<int>::iterator i;
+
+    for (i = visible.begin(); i != visible.end(); i++)
+    {
+        glPushMatrix();
+        glTranslatef(centerX[*i], centerY[*i], centerZ[*i]);
+        glColor3ubv(&color[3 * *i]);
+        shapeCacheWireSphere(radius[*i], slicesOf(radius[*i]),
+                             slicesOf(radius[*i]));
+        glPopMatrix();
+    }
+}
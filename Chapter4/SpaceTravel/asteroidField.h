@@ -0,0 +1,101 @@
+/////////////////////////////////////////////////////////////////////////////
+// asteroidField.h
+//
+// The asteroids of spaceTravel.cpp, stored structure-of-arrays: one array
+// each of center x, y and z, radius and color, indexed by asteroid.
+//
+// Where instanced arrays are available (OpenGL 3.3 or
+// GL_ARB_instanced_arrays) the arrays are copied into one instance buffer,
+// laid out the same way, and the field is drawn with one instanced call per
+// sphere tessellation in use; as all asteroids of spaceTravel.cpp have the
+// same radius, that is one call per viewport. Otherwise each asteroid is
+// drawn in turn from the shape cache.
+//
+// Before drawing, the asteroids are culled against the view frustum: their
+// bounding spheres are tested against the six frustum planes, four at a time
+// with SSE, straight from the center and radius arrays. Only the asteroids
+// left are drawn, instanced from a stream buffer they are gathered into.
+//
+// Where viewport arrays and geometry shader invocations are available
+// (GL_ARB_viewport_array and GL_ARB_gpu_shader5) drawViews() draws the field
+// into two views at once: each asteroid inside either view frustum is
+// submitted once and a geometry shader emits every line into both
+// viewports, projected by that view's matrix. Elsewhere callers draw each
+// view in turn with draw().
+//
+// upload() also buckets the asteroids into a uniform grid over the xz-plane,
+// with cells sized for about one asteroid each, so that a collision query
+// only tests the asteroids in the few cells its sphere can reach.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef ASTEROID_FIELD_H
+#define ASTEROID_FIELD_H
+
+#include <vector>
+
+// Numbers of asteroids drawn and culled, accumulated over frames.
+struct CullStats
+{
+    unsigned long frames, drawn, culled;
+};
+
+// A viewport and the projection * modelview drawn into it.
+struct View
+{
+    int viewport[4];
+    float matrix[16];
+};
+
+void captureView(View &view);
+
+class AsteroidField
+{
+public:
+    AsteroidField();
+    void add(float x, float y, float z, float r, unsigned char colorR,
+             unsigned char colorG, unsigned char colorB);
+    int size() const { return centerX.size(); }
+    void upload(int allowInstancing);
+    void draw(CullStats &stats);
+    void drawViews(const View views[2], CullStats stats[2]);
+    int isInstanced() const { return program != 0; }
+    int isMultiView() const { return multiViewProgram != 0; }
+    int intersectsSphere(float x, float y, float z, float r) const;
+
+    // Per-asteroid data.
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<unsigned char> color; // RGB triples.
+    int culling; // Frustum cull before drawing? On by default.
+    // Build the multi-view program in upload() if supported? Off by default.
+    int multiView;
+
+private:
+    // Run of asteroids, contiguous after upload(), sharing a tessellation.
+    struct Group
+    {
+        int first, count, slices;
+    };
+
+    void sortByTessellation();
+    void buildGrid();
+    void cull(const float m[16], std::vector<int> &inFrustum) const;
+    void drawInstanced(unsigned int shaders);
+    void drawEach();
+
+    std::vector<Group> groups;
+    std::vector<int> visible; // Asteroids left by cull().
+    unsigned int instanceBuffer; // Instance buffer id.
+    unsigned int streamBuffer; // Buffer id for the visible asteroids' data.
+    unsigned int program; // Instancing program id, 0 if not instanced.
+    unsigned int multiViewProgram; // Multi-view program id, 0 if none.
+
+    // Collision grid: cell (i, k) covers x in gridX + cellSize * [i, i + 1)
+    // and z likewise, and holds the asteroids whose centers lie in it, namely
+    // cellAsteroids[cellStart[c]] to cellAsteroids[cellStart[c + 1] - 1]
+    // with c = k * cellsX + i.
+    float gridX, gridZ, cellSize, maxRadius;
+    int cellsX, cellsZ;
+    std::vector<int> cellStart, cellAsteroids;
+};
+
+#endif
@@ -6,11 +6,26 @@
 // camera; the view in the right viewport is from the spacecraft.
 // There is approximate collision detection.
 // 
-// User-defined constants: 
-// ROW is the number of rows of  asteroids.
-// COLUMN is the number of columns of asteroids.
-// FILL_PROBABILITY is the percentage probability that a particular row-column
-// slot will be filled with an asteroid.
+// Options (after the harness options, see harness.h):
+// --rows N is the number of rows of asteroids (default 8).
+// --columns N is the number of columns of asteroids (default 6).
+// --fill P is the percentage probability that a particular row-column
+// slot will be filled with an asteroid (default 100).
+// --no-instancing draws the asteroids one at a time even where instanced
+// drawing is available (see asteroidField.h).
+// --no-culling draws every asteroid in each viewport, not only those inside
+// its view frustum.
+// --single-pass draws the asteroids of both viewports with one submission
+// where supported (see asteroidField.h), instead of once per viewport.
+// On llvmpipe the geometry shader costs more than the second pass saves, so
+// it is off by default.
+// --compare-passes N benchmarks the two paths on the same field: run
+// headless, it draws N frames each way, alternating between them, writes
+// the mean and median frame time of each and exits, e.g.
+//    ./prog42 --headless --rows 200 --columns 200 --compare-passes 300
+//
+// At exit the average numbers of asteroids drawn and culled per frame in
+// each viewport are written.
 //
 // Interaction:
 // Press the left/right arrow keys to turn the craft.
@@ -23,20 +38,33 @@
 
 #include <cstdlib>
 #include <cmath>
+#include <ctime>
 #include <iostream>
 #include <cstring>
+#include <vector>
+#include <algorithm>
 
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 
-#define ROWS 8  // Number of rows of asteroids.
-#define COLUMNS 6 // Number of columns of asteroids.
-// Percentage probability that a particular row-column slot will be 
-// filled with an asteroid. It should be an integer between 0 and 100.
-#define FILL_PROBABILITY 100
-
+#include "harness.h"
+#include "frameStats.h"
+#include "shapeCache.h"
+#include "asteroidField.h"
 
 // Globals.
+static int rows = 8; // Number of rows of asteroids.
+static int columns = 6; // Number of columns of asteroids.
+// Percentage probability that a particular row-column slot will be 
+// filled with an asteroid. It should be an integer between 0 and 100.
+static int fillProbability = 100;
+static int instancing = 1; // Draw the asteroids instanced if possible?
+static AsteroidField asteroids; // All the asteroids.
+// Asteroids drawn and culled in the left and right viewports.
+static CullStats viewStats[2] = { { 0, 0, 0 }, { 0, 0, 0 } };
+static View views[2]; // Left and right views, for drawing in one pass.
+static int singlePass = 0; // Draw the asteroids of both views in one pass?
+static int comparePassFrames = 0; // Frames each way for --compare-passes.
 static long font = (long)GLUT_BITMAP_8_BY_13; // Font selection.
 static int width, height; // Size of the OpenGL window.
 static float angle = 0.0; // Angle of the spacecraft.
@@ -44,7 +72,6 @@ static float xVal = 0, zVal = 0; // Co-ordinates of the spacecraft.
 // Is there collision between the spacecraft and an asteroid?
 static int isCollision = 0;
 static unsigned int spacecraft; // Display lists base index.
-static int frameCount = 0; // Number of frames
 
 // Routine to draw a bitmap character string.
 void writeBitmapString(void *font, std::string string)
@@ -55,75 +82,7 @@ void writeBitmapString(void *font, std::string string)
     strcpy(s, string.data());
 
     for (c = s; *c != '\0'; c++)
-        glutBitmapCharacter(font, *c);
-}
-
-// Asteroid class.
-class Asteroid
-{
-public:
-    Asteroid();
-    Asteroid(float x, float y, float z, float r, unsigned char colorR,
-        unsigned char colorG, unsigned char colorB);
-    float getCenterX() { return centerX; }
-    float getCenterY() { return centerY; }
-    float getCenterZ() { return centerZ; }
-    float getRadius() { return radius; }
-    void draw();
-
-private:
-    float centerX, centerY, centerZ, radius;
-    unsigned char color[3];
-};
-
-// Asteroid default constructor.
-Asteroid::Asteroid()
-{
-    centerX = 0.0;
-    centerY = 0.0;
-    centerZ = 0.0;
-    radius = 0.0; // Indicates no asteroid exists in the position.
-    color[0] = 0;
-    color[1] = 0;
-    color[2] = 0;
-}
-
-// Asteroid constructor.
-Asteroid::Asteroid(float x, float y, float z, float r, unsigned char colorR,
-    unsigned char colorG, unsigned char colorB)
-{
-    centerX = x;
-    centerY = y;
-    centerZ = z;
-    radius = r;
-    color[0] = colorR;
-    color[1] = colorG;
-    color[2] = colorB;
-}
-
-// Function to draw asteroid.
-void Asteroid::draw()
-{
-    if (radius > 0.0) // If asteroid exists.
-    {
-        glPushMatrix();
-        glTranslatef(centerX, centerY, centerZ);
-        glColor3ubv(color);
-        glutWireSphere(radius, (int)radius * 6, (int)radius * 6);
-        glPopMatrix();
-    }
-}
-
-Asteroid arrayAsteroids[ROWS][COLUMNS]; // Global array of asteroids.
-
-// Routine to count the number of frames drawn every second.
-void frameCounter(int value)
-{
-    // No output the first time frameCounter() is called (from main()).
-   if (value != 0)
-      std::cout << "FPS = " << frameCount << std::endl;
-   frameCount = 0;
-   glutTimerFunc(1000, frameCounter, 1);
+        harnessBitmapCharacter(font, *c);
 }
 
 // Initialization routine.
@@ -137,46 +96,34 @@ void setup(void)
     // To make the spacecraft point down the $z$-axis initially.
     glRotatef(180.0, 0.0, 1.0, 0.0);
     glColor3f(1.0, 1.0, 1.0);
-    glutWireCone(5.0, 10.0, 10, 10);
+    shapeCacheWireCone(5.0, 10.0, 10, 10);
     glPopMatrix();
     glEndList();
 
-    // Initialize global arrayAsteroids.
-    for (j = 0; j<COLUMNS; j++)
-        for (i = 0; i<ROWS; i++)
-            if (rand() % 100 < FILL_PROBABILITY)
-                // If rand()%100 >= FILL_PROBABILITY the default constructor
-                // asteroid remains in the slot which indicates that there is
-                // no asteroid there because the default's radius is 0.
+    // Initialize the asteroid field.
+    for (j = 0; j<columns; j++)
+        for (i = 0; i<rows; i++)
+            if (rand() % 100 < fillProbability)
+                // If rand()%100 >= fillProbability the row-column slot is
+                // left empty.
             {
                 // Position the asteroids depending on if there is an even or
                 // odd number of columns so that the spacecraft faces the
                 // middle of the asteroid field.
-                if (COLUMNS % 2) // Odd number of columns.
-                    arrayAsteroids[i][j] =
-                        Asteroid(30.0*(-COLUMNS / 2 + j), 0.0, -40.0 - 30.0*i,
-                                 3.0, rand() % 256, rand() % 256,
-                                 rand() % 256);
+                if (columns % 2) // Odd number of columns.
+                    asteroids.add(30.0*(-columns / 2 + j), 0.0, -40.0 - 30.0*i,
+                                  3.0, rand() % 256, rand() % 256,
+                                  rand() % 256);
                 else // Even number of columns.
-                    arrayAsteroids[i][j] =
-                        Asteroid(15 + 30.0*(-COLUMNS / 2 + j), 0.0,
-                                 -40.0 - 30.0*i, 3.0, rand() % 256,
-                                 rand() % 256, rand() % 256);
+                    asteroids.add(15 + 30.0*(-columns / 2 + j), 0.0,
+                                  -40.0 - 30.0*i, 3.0, rand() % 256,
+                                  rand() % 256, rand() % 256);
             }
+    asteroids.upload(instancing);
+    singlePass = asteroids.isMultiView();
 
     glEnable(GL_DEPTH_TEST);
     glClearColor(0.0, 0.0, 0.0, 0.0);
-
-    glutTimerFunc(0, frameCounter, 0); // Initial call of frameCounter().
-}
-
-// Function to check if two spheres centered at (x1,y1,z1) and (x2,y2,z2) with
-// radius r1 and r2 intersect.
-int checkSpheresIntersection(float x1, float y1, float z1, float r1,
-    float x2, float y2, float z2, float r2)
-{
-    return ((x1 - x2)*(x1 - x2) + (y1 - y2)*(y1 - y2) + (z1 - z2)*(z1 - z2)
-            <= (r1 + r2)*(r1 + r2));
 }
 
 // Function to check if the spacecraft collides with an asteroid when the
@@ -186,29 +133,16 @@ int checkSpheresIntersection(float x1, float y1, float z1, float r1,
 // bounding sphere.
 int asteroidCraftCollision(float x, float z, float a)
 {
-    int i, j;
+    // Center of the bounding sphere, halfway along the craft.
+    float centerX = x - 5 * sin((M_PI / 180.0) * a);
+    float centerZ = z - 5 * cos((M_PI / 180.0) * a);
 
-    // Check for collision with each asteroid.
-    for (j = 0; j<COLUMNS; j++)
-        for (i = 0; i<ROWS; i++)
-            if (arrayAsteroids[i][j].getRadius() > 0) // If asteroid exists.
-                if (checkSpheresIntersection(x - 5 * sin((M_PI / 180.0) * a),
-                                             0.0, z - 5 * cos((M_PI / 180.0)
-                                                              * a), 7.072,
-                                             arrayAsteroids[i][j].getCenterX(),
-                                             arrayAsteroids[i][j].getCenterY(),
-                                             arrayAsteroids[i][j].getCenterZ(),
-                                             arrayAsteroids[i][j].getRadius()))
-                    return 1;
-    return 0;
+    return asteroids.intersectsSphere(centerX, 0.0, centerZ, 7.072);
 }
 
 // Drawing routine.
 void drawScene(void)
 {
-   frameCount++; // Increment number of frames every redraw.
-   
-   int i, j;
    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
    // Begin left viewport.
@@ -226,10 +160,10 @@ void drawScene(void)
    // Fixed camera.
    gluLookAt(0.0, 10.0, 20.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0);
 
-   // Draw all the asteroids in arrayAsteroids.
-   for (j = 0; j<COLUMNS; j++)
-      for (i = 0; i<ROWS; i++)
-         arrayAsteroids[i][j].draw();
+   // Draw all the asteroids in view, or leave them to be drawn with the
+   // right viewport's in one pass.
+   if (singlePass) captureView(views[0]);
+   else asteroids.draw(viewStats[0]);
 
     // Draw spacecraft.
     glPushMatrix();
@@ -273,13 +207,16 @@ void drawScene(void)
         1.0,
         0.0);
 
-    // Draw all the asteroids in arrayAsteroids.
-    for (j = 0; j<COLUMNS; j++)
-        for (i = 0; i<ROWS; i++)
-            arrayAsteroids[i][j].draw();
+    // Draw all the asteroids in view, in both viewports if in one pass.
+    if (singlePass)
+    {
+        captureView(views[1]);
+        asteroids.drawViews(views, viewStats);
+    }
+    else asteroids.draw(viewStats[1]);
     // End right viewport.
 
-    glutSwapBuffers();
+    harnessSwapBuffers();
 }
 
 // OpenGL window reshape routine.
@@ -347,7 +284,7 @@ void specialKeyInput(int key, int x, int y)
     }
     else isCollision = 1;
 
-    glutPostRedisplay();
+    harnessPostRedisplay();
 }
 
 // Routine to output interaction instructions to the C++ window.
@@ -360,29 +297,123 @@ void printInteraction(void)
               << std::endl;
 }
 
+// Routine to write the asteroids drawn and culled per frame in a viewport.
+void writeViewportStats(const char *name, const CullStats &stats)
+{
+    if (stats.frames == 0) return;
+    std::cout << name << " viewport: " << (float)stats.drawn / stats.frames
+              << " asteroids drawn, " << (float)stats.culled / stats.frames
+              << " culled per frame." << std::endl;
+}
+
+// Routine to write the culling statistics at exit.
+void writeCullStats(void)
+{
+    writeViewportStats("Left", viewStats[0]);
+    writeViewportStats("Right", viewStats[1]);
+}
+
+// Routine to write the mean and median of frame times in ms.
+void writeFrameTimes(const char *name, std::vector<double> &times)
+{
+    double total = 0.0;
+    size_t i;
+
+    for (i = 0; i < times.size(); i++) total += times[i];
+    std::sort(times.begin(), times.end());
+    std::cout << name << ": mean " << total / times.size() << " ms, median "
+              << times[times.size() / 2] << " ms per frame." << std::endl;
+}
+
+// Routine to benchmark drawing the asteroids in two passes against one:
+// frames frames are drawn each way, alternately so that both see the same
+// conditions, after a frame of each to warm up, and each timed to the end
+// of its rendering.
+void comparePasses(int frames)
+{
+    std::vector<double> times[2]; // Two-pass and single-pass frame times.
+    struct timespec start, end;
+    int i;
+
+    if (!harnessIsHeadless() || !asteroids.isMultiView())
+    {
+        std::cerr << "--compare-passes needs --headless and single-pass "
+                  << "drawing to be supported." << std::endl;
+        exit(1);
+    }
+
+    resize(800, 400);
+    for (i = -2; i < 2 * frames; i++)
+    {
+        singlePass = i & 1;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        drawScene();
+        glFinish();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (i >= 0)
+            times[singlePass].push_back((end.tv_sec - start.tv_sec) * 1000.0 +
+                                        (end.tv_nsec - start.tv_nsec) / 1.0e6);
+    }
+
+    std::cout << asteroids.size() << " asteroids, " << frames
+              << " frames each way:" << std::endl;
+    writeFrameTimes("Two passes", times[0]);
+    writeFrameTimes("Single pass", times[1]);
+    exit(0);
+}
+
+// Routine to read the options left in argv by harnessInit().
+void readOptions(int argc, char **argv)
+{
+    int i;
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--rows") && i + 1 < argc)
+            rows = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--columns") && i + 1 < argc)
+            columns = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--fill") && i + 1 < argc)
+            fillProbability = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--no-instancing"))
+            instancing = 0;
+        else if (!strcmp(argv[i], "--no-culling"))
+            asteroids.culling = 0;
+        else if (!strcmp(argv[i], "--single-pass"))
+            asteroids.multiView = 1;
+        else if (!strcmp(argv[i], "--compare-passes") && i + 1 < argc)
+        {
+            comparePassFrames = atoi(argv[++i]);
+            asteroids.multiView = 1;
+        }
+    }
+}
+
 // Main routine.
 int main(int argc, char **argv)
 {
     printInteraction();
-    glutInit(&argc, argv);
+    harnessInit(&argc, argv);
+    readOptions(argc, argv);
+    atexit(writeCullStats);
 
     glutInitContextVersion(3, 1);
     glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
-    glutInitWindowSize(800, 400);
+    harnessInitWindowSize(800, 400);
     glutInitWindowPosition(100, 100);
-    glutCreateWindow("spaceTravel.cpp");
-    glutDisplayFunc(drawScene);
-    glutReshapeFunc(resize);
-    glutKeyboardFunc(keyInput);
-    glutSpecialFunc(specialKeyInput);
+    harnessCreateWindow("spaceTravel.cpp");
+    frameStatsDisplayFunc(drawScene); // Draw with frame-time telemetry.
+    harnessReshapeFunc(resize);
+    harnessKeyboardFunc(keyInput);
+    harnessSpecialFunc(specialKeyInput);
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     setup();
+    if (comparePassFrames > 0) comparePasses(comparePassFrames);
 
-    glutMainLoop();
+    harnessMainLoop();
 }
 
@@ -22,17 +22,19 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 
+#include "harness.h"
+#include "mesh.h"
+
 // Globals.
 static float R = 5.0; // Radius of hemisphere.
 static int p = 20; // Number of longitudinal slices.
 static int q = 5; // Number of latitudinal slices.
 static float Xangle = 120.0, Yangle = 120.0, Zangle = 0.0; // Angles to rotate hemisphere.
+static Mesh top, bottom; // Top hemisphere and bottom half-hemisphere.
 
 // Drawing routine.
 void drawScene(void)
 {
-    int  i, j;
-
     glClear(GL_COLOR_BUFFER_BIT);
 
     glLoadIdentity();
@@ -51,45 +53,23 @@ void drawScene(void)
     glPolygonMode(GL_BACK, GL_LINE);
     glColor3f(0.0, 0.0, 0.0);
 
-    // Top hemisphere.
-    for (j = 0; j < q; j++)
-    {
-        glBegin(GL_TRIANGLE_STRIP); // One latitudinal strip.
-        for (i = 0; i <= p; i++)
-        {
-            glVertex3f(R * cos((float)(j + 1) / q * M_PI / 2.0) * cos(2.0 * (float)i / p * M_PI),
-                R * sin((float)(j + 1) / q * M_PI / 2.0),
-                -R * cos((float)(j + 1) / q * M_PI / 2.0) * sin(2.0 * (float)i / p * M_PI));
-            glVertex3f(R * cos((float)j / q * M_PI / 2.0) * cos(2.0 * (float)i / p * M_PI),
-                R * sin((float)j / q * M_PI / 2.0),
-                -R * cos((float)j / q * M_PI / 2.0) * sin(2.0 * (float)i / p * M_PI));
-        }
-        glEnd();
-    }
+    meshDraw(top);
+    meshDraw(bottom);
 
-    // Bottom half-hemisphere.
-    for (j = 0; j < q; j++)
-    {
-        glBegin(GL_TRIANGLE_STRIP);
-        for (i = 0; i <= p / 2; i++) // Half a latitudinal strip.
-        {
-            glVertex3f(R * cos((float)(j + 1) / q * M_PI / 2.0) * cos(2.0 * (float)i / p * M_PI),
-                -R * sin((float)(j + 1) / q * M_PI / 2.0), // Negative y-value.
-                -R * cos((float)(j + 1) / q * M_PI / 2.0) * sin(2.0 * (float)i / p * M_PI));
-            glVertex3f(R * cos((float)j / q * M_PI / 2.0) * cos(2.0 * (float)i / p * M_PI),
-                -R * sin((float)j / q * M_PI / 2.0), // Negative y-value.
-                -R * cos((float)j / q * M_PI / 2.0) * sin(2.0 * (float)i / p * M_PI));
-        }
-        glEnd();
-    }
-
-    glutSwapBuffers();
+    harnessSwapBuffers();
 }
 
 // Initialization routine.
 void setup(void)
 {
     glClearColor(1.0, 1.0, 1.0, 0.0);
+
+    top = meshHemisphere(R, p, q);
+
+    // Half a hemisphere below the equator: longitudes up to p / 2 slices and
+    // latitudes down to the south pole.
+    bottom = meshPartialSphere(R, p / 2, q, 0.0, 2.0 * (p / 2) / p * M_PI, 0.0,
+                               -M_PI / 2.0);
 }
 
 // OpenGL window reshape routine.
@@ -113,32 +93,32 @@ void keyInput(unsigned char key, int x, int y)
     case 'x':
         Xangle += 5.0;
         if (Xangle > 360.0) Xangle -= 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'X':
         Xangle -= 5.0;
         if (Xangle < 0.0) Xangle += 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'y':
         Yangle += 5.0;
         if (Yangle > 360.0) Yangle -= 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'Y':
         Yangle -= 5.0;
         if (Yangle < 0.0) Yangle += 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'z':
         Zangle += 5.0;
         if (Zangle > 360.0) Zangle -= 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     case 'Z':
         Zangle -= 5.0;
         if (Zangle < 0.0) Zangle += 360.0;
-        glutPostRedisplay();
+        harnessPostRedisplay();
         break;
     default:
         break;
@@ -156,24 +136,24 @@ void printInteraction(void)
 int main(int argc, char **argv)
 {
     printInteraction();
-    glutInit(&argc, argv);
+    harnessInit(&argc, argv);
 
     glutInitContextVersion(3, 1);
     glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
-    glutInitWindowSize(500, 500);
+    harnessInitWindowSize(500, 500);
     glutInitWindowPosition(100, 100);
-    glutCreateWindow("threeQuarterSphere.cpp");
-    glutDisplayFunc(drawScene);
-    glutReshapeFunc(resize);
-    glutKeyboardFunc(keyInput);
+    harnessCreateWindow("threeQuarterSphere.cpp");
+    harnessDisplayFunc(drawScene);
+    harnessReshapeFunc(resize);
+    harnessKeyboardFunc(keyInput);
 
     glewExperimental = GL_TRUE;
     glewInit();
 
     setup();
 
-    glutMainLoop();
+    harnessMainLoop();
 }
 
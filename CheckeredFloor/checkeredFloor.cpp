@@ -11,6 +11,9 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 
+#include "harness.h"
+#include "immediate.h"
+
 // Initialization routine.
 void setup(void)
 {
@@ -114,23 +117,23 @@ void keyInput(unsigned char key, int x, int y)
 // Main routine.
 int main(int argc, char **argv)
 {
-	glutInit(&argc, argv);
+	harnessInit(&argc, argv);
 
 	glutInitContextVersion(3, 1);
 	glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
 	glutInitDisplayMode(GLUT_SINGLE | GLUT_RGBA | GLUT_DEPTH);
-	glutInitWindowSize(500, 500);
+	harnessInitWindowSize(500, 500);
 	glutInitWindowPosition(100, 100);
-	glutCreateWindow("checkeredFloor.cpp");
-	glutDisplayFunc(drawScene);
-	glutReshapeFunc(resize);
-	glutKeyboardFunc(keyInput);
+	harnessCreateWindow("checkeredFloor.cpp");
+	harnessDisplayFunc(drawScene);
+	harnessReshapeFunc(resize);
+	harnessKeyboardFunc(keyInput);
 
 	glewExperimental = GL_TRUE;
 	glewInit();
 
 	setup();
 
-	glutMainLoop();
+	harnessMainLoop();
 }
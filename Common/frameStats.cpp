@@ -0,0 +1,312 @@
+/////////////////////////////////////////////////////////////////////////////
+// frameStats.cpp
+//
+// Implementation of the frame-time telemetry declared in frameStats.h.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+#include "harness.h"
+#include "frameStats.h"
+
+#define RING_SIZE 1024 // Sample ring buffer capacity, a power of 2.
+#define QUERIES 4 // GPU timer queries in flight.
+#define REPORT_PERIOD 1000 // ms between reports.
+#define SKETCH_STEPS 16 // Percentile sketch buckets per doubling of time.
+#define SKETCH_BUCKETS 416 // Percentile sketch buckets, 1/1024 ms to 65 s.
+
+// One frame's telemetry.
+struct FrameSample
+{
+    unsigned long frame; // Frame number.
+    float wall; // Wall time in ms.
+    float cpu; // CPU submit time in ms.
+    float gpu; // GPU time in ms, negative if unavailable.
+};
+
+// Single-producer/single-consumer ring buffer of samples: the drawing
+// routine pushes, the reporter pops, neither ever blocks.
+class SampleRing
+{
+public:
+    SampleRing() : head(0), tail(0) {}
+    bool push(const FrameSample &sample);
+    bool pop(FrameSample &sample);
+
+private:
+    FrameSample samples[RING_SIZE];
+    std::atomic<unsigned long> head; // Next slot to write.
+    std::atomic<unsigned long> tail; // Next slot to read.
+};
+
+// Routine to add a sample; fails if the ring is full.
+bool SampleRing::push(const FrameSample &sample)
+{
+    unsigned long h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == RING_SIZE) return false;
+    samples[h & (RING_SIZE - 1)] = sample;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+// Routine to remove the oldest sample; fails if the ring is empty.
+bool SampleRing::pop(FrameSample &sample)
+{
+    unsigned long t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return false;
+    sample = samples[t & (RING_SIZE - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+// Fixed-size sketch of a time's distribution over the whole run, for the
+// exit summary: a histogram of buckets growing geometrically from 1/1024 ms,
+// so a percentile read back is within 2.2% of the exact one.
+class TimeSketch
+{
+public:
+    TimeSketch() : count(0) { std::fill(buckets, buckets + SKETCH_BUCKETS, 0ul); }
+    void add(float ms);
+    float percentile(float p) const;
+    unsigned long count;
+
+private:
+    unsigned long buckets[SKETCH_BUCKETS];
+};
+
+// Routine to add a time to the sketch.
+void TimeSketch::add(float ms)
+{
+    int i = ms * 1024.0 > 1.0 ? (int)(std::log2(ms * 1024.0) * SKETCH_STEPS) : 0;
+    buckets[std::min(i, SKETCH_BUCKETS - 1)]++;
+    count++;
+}
+
+// Routine to return the p-th percentile (nearest rank), as the geometric
+// middle of its bucket.
+float TimeSketch::percentile(float p) const
+{
+    unsigned long rank = (unsigned long)(p / 100.0 * count + 0.5), seen = 0;
+    int i;
+
+    if (rank < 1) rank = 1;
+    for (i = 0; i < SKETCH_BUCKETS - 1; i++)
+        if ((seen += buckets[i]) >= rank) break;
+    return std::exp2((i + 0.5) / SKETCH_STEPS) / 1024.0;
+}
+
+// Globals.
+static void (*displayFunc)(void) = NULL; // The program's drawing routine.
+static SampleRing ring;
+static std::vector<FrameSample> window; // Samples of the current report.
+static TimeSketch wallSketch, cpuSketch, gpuSketch; // Samples of the run.
+static const float bounds[] = { 1, 2, 4, 8, 16, 33, 66, 133 }; // Histogram.
+static const int buckets = sizeof(bounds) / sizeof(bounds[0]) + 1;
+static unsigned long counts[buckets]; // Wall times in each histogram bucket.
+static std::ofstream csvFile; // FRAME_STATS_CSV, if set.
+static unsigned long frameNumber = 0;
+static unsigned long dropped = 0; // Samples lost to a full ring.
+static double lastStart = -1.0; // Start of the previous frame.
+static int useQueries = -1; // GPU timer queries? -1 until checked.
+static unsigned int queries[QUERIES];
+static FrameSample pending[QUERIES]; // Samples awaiting their GPU time.
+static unsigned long issued = 0, resolved = 0; // Query counters.
+
+// Routine to return the monotonic clock in ms.
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1.0e6;
+}
+
+static void pushSample(const FrameSample &sample)
+{
+    if (!ring.push(sample)) dropped++;
+}
+
+// Routine to collect finished GPU queries, oldest first. With wait set,
+// block until all of them are done.
+static void resolveQueries(int wait)
+{
+    GLint available;
+    GLuint64 elapsed;
+
+    while (resolved < issued)
+    {
+        unsigned int query = queries[resolved % QUERIES];
+        if (!wait)
+        {
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) return;
+        }
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        pending[resolved % QUERIES].gpu = elapsed / 1.0e6;
+        pushSample(pending[resolved % QUERIES]);
+        resolved++;
+    }
+}
+
+// Drawing routine wrapper that takes the measurements.
+static void timedDisplay(void)
+{
+    FrameSample sample;
+    double start = now();
+
+    if (useQueries < 0)
+    {
+        useQueries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+        if (useQueries) glGenQueries(QUERIES, queries);
+    }
+
+    // Make room for this frame's query.
+    if (useQueries && issued - resolved == QUERIES) resolveQueries(1);
+
+    if (useQueries) glBeginQuery(GL_TIME_ELAPSED, queries[issued % QUERIES]);
+    displayFunc();
+    if (useQueries) glEndQuery(GL_TIME_ELAPSED);
+
+    sample.frame = frameNumber++;
+    sample.cpu = now() - start;
+    sample.wall = lastStart < 0.0 ? sample.cpu : start - lastStart;
+    sample.gpu = -1.0;
+    lastStart = start;
+
+    if (useQueries)
+    {
+        pending[issued++ % QUERIES] = sample;
+        resolveQueries(0);
+    }
+    else pushSample(sample);
+}
+
+// Routine to return the p-th percentile (nearest rank) of sorted values.
+static float percentile(const std::vector<float> &values, float p)
+{
+    size_t rank = (size_t)(p / 100.0 * values.size() + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > values.size()) rank = values.size();
+    return values[rank - 1];
+}
+
+// Routine to write p50/p95/p99 of one field of the window's samples.
+static void writePercentiles(const char *name, float FrameSample::*field)
+{
+    std::vector<float> values;
+    std::vector<FrameSample>::iterator sample;
+
+    for (sample = window.begin(); sample != window.end(); sample++)
+        if ((*sample).*field >= 0.0) values.push_back((*sample).*field);
+    if (values.empty()) return;
+
+    std::sort(values.begin(), values.end());
+    std::cout << " " << name << " p50/p95/p99 = " << percentile(values, 50.0)
+              << "/" << percentile(values, 95.0) << "/"
+              << percentile(values, 99.0);
+}
+
+// Routine to write p50/p95/p99 of a sketch.
+static void writePercentiles(const char *name, const TimeSketch &sketch)
+{
+    if (sketch.count == 0) return;
+    std::cout << " " << name << " p50/p95/p99 = " << sketch.percentile(50.0)
+              << "/" << sketch.percentile(95.0) << "/"
+              << sketch.percentile(99.0);
+}
+
+// Routine to move samples from the ring to the window, adding them to the
+// run's sketches and histogram and to the CSV file.
+static void drainRing(void)
+{
+    FrameSample sample;
+    int i;
+
+    while (ring.pop(sample))
+    {
+        window.push_back(sample);
+        wallSketch.add(sample.wall);
+        cpuSketch.add(sample.cpu);
+        if (sample.gpu >= 0.0) gpuSketch.add(sample.gpu);
+        for (i = 0; i < buckets - 1 && sample.wall >= bounds[i]; i++);
+        counts[i]++;
+
+        if (csvFile.is_open())
+        {
+            csvFile << sample.frame << "," << sample.wall << "," << sample.cpu
+                    << ",";
+            if (sample.gpu >= 0.0) csvFile << sample.gpu;
+            csvFile << "\n";
+        }
+    }
+}
+
+// Timer routine writing the statistics of the last period.
+static void report(int value)
+{
+    drainRing();
+    if (value != 0 && !window.empty())
+    {
+        std::cout << "Frames = " << window.size() << " (ms):";
+        writePercentiles("wall", &FrameSample::wall);
+        writePercentiles("cpu", &FrameSample::cpu);
+        writePercentiles("gpu", &FrameSample::gpu);
+        std::cout << std::endl;
+    }
+    window.clear();
+    harnessTimerFunc(REPORT_PERIOD, report, 1);
+}
+
+// Routine to write the histogram of wall times at exit. The GPU times of
+// the last frames are waited for; the context is still current, the
+// harness tearing its own down in an exit routine registered before this.
+static void writeSummary(void)
+{
+    int i;
+
+    if (useQueries > 0) resolveQueries(1);
+    drainRing();
+    csvFile.close();
+    if (wallSketch.count == 0) return;
+
+    std::cout << "Frame time histogram over " << wallSketch.count << " frames";
+    if (dropped) std::cout << " (" << dropped << " dropped)";
+    std::cout << ":" << std::endl;
+    writePercentiles("wall", wallSketch);
+    writePercentiles("cpu", cpuSketch);
+    writePercentiles("gpu", gpuSketch);
+    std::cout << std::endl;
+    for (i = 0; i < buckets; i++)
+    {
+        if (i < buckets - 1) std::cout << " < " << bounds[i] << " ms\t";
+        else std::cout << ">= " << bounds[i - 1] << " ms\t";
+        std::cout << counts[i] << "\t"
+                  << std::string(counts[i] * 50 / wallSketch.count, '#')
+                  << std::endl;
+    }
+}
+
+void frameStatsDisplayFunc(void (*func)(void))
+{
+    const char *csvName = getenv("FRAME_STATS_CSV");
+
+    if (csvName)
+    {
+        csvFile.open(csvName);
+        csvFile << "frame,wall_ms,cpu_ms,gpu_ms" << std::endl;
+    }
+
+    displayFunc = func;
+    harnessDisplayFunc(timedDisplay);
+    harnessTimerFunc(0, report, 0);
+    atexit(writeSummary);
+}
@@ -0,0 +1,28 @@
+/////////////////////////////////////////////////////////////////////////////
+// frameStats.h
+//
+// Frame-time telemetry. A program links it with one call in main(),
+//
+//     frameStatsDisplayFunc(drawScene);
+//
+// in place of harnessDisplayFunc(drawScene). Every frame then records:
+// wall time (start of one frame to the start of the next), CPU submit time
+// (time spent inside the drawing routine) and, where GL_ARB_timer_query is
+// available, GPU time from GL_TIME_ELAPSED queries. Samples go through a
+// lock-free single-producer/single-consumer ring buffer.
+//
+// Once a second the p50/p95/p99 of each time are written to stdout. At exit
+// a histogram of the frame times and their p50/p95/p99 over the whole run
+// (from a fixed-size sketch, to within 2.2%) are written. If the environment
+// variable FRAME_STATS_CSV names a file, every sample is written to it as
+// CSV as it is collected. Only the current second's samples are kept, so a
+// long run takes no more memory than a short one.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+// Routine to register func as the drawing routine with telemetry enabled.
+void frameStatsDisplayFunc(void (*func)(void));
+
+#endif
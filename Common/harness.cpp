@@ -0,0 +1,532 @@
+/////////////////////////////////////////////////////////////////////////////
+// harness.cpp
+//
+// Implementation of the windowed/headless harness declared in harness.h.
+//
+// Headless mode renders into a framebuffer object attached to a surfaceless
+// EGL context, so nothing beyond Mesa's software rasterizer is required.
+//
+// An input log is a header (the characters "GLIR" and a 32-bit version)
+// followed by one 12-byte little-endian record per event: a 32-bit time in
+// ms since the event loop started, the event type, the key or button, the
+// button state, a padding byte and the 16-bit x and y mouse co-ordinates.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "harness.h"
+
+// Synthetic timer.
+struct HarnessTimer
+{
+    long due; // Synthetic time, in ms, at which the timer fires.
+    void (*func)(int);
+    int value;
+};
+
+#define LOG_MAGIC "GLIR" // Input log signature.
+#define LOG_VERSION 1 // Input log format version.
+#define LOG_RECORD_SIZE 12 // Bytes per logged event.
+
+// Logged input event types.
+enum { EVENT_KEYBOARD, EVENT_SPECIAL, EVENT_MOUSE };
+
+// Logged input event.
+struct InputEvent
+{
+    unsigned int time; // ms since the event loop started.
+    unsigned char type, code, state; // Type, key or button, button state.
+    short x, y; // Mouse position.
+};
+
+// Globals.
+static int headless = 0; // Running headless?
+static int frames = -1; // Number of frames to draw headless, -1 if unset.
+static int frameTime = 16; // Synthetic ms per headless frame.
+static int windowWidth = 300, windowHeight = 300; // GLUT default size.
+static long syntheticTime = 0; // Synthetic clock in ms.
+static std::vector<HarnessTimer> timers; // Pending synthetic timers.
+static void (*displayFunc)(void) = NULL;
+static void (*reshapeFunc)(int, int) = NULL;
+static void (*idleFunc)(void) = NULL;
+static void (*keyboardFunc)(unsigned char, int, int) = NULL;
+static void (*specialFunc)(int, int, int) = NULL;
+static void (*mouseFunc)(int, int, int, int) = NULL;
+static FILE *recordFile = NULL; // Input log being written.
+static FILE *replayFile = NULL; // Input log being replayed.
+static float replaySpeed = 1.0; // Replay rate relative to the original.
+static InputEvent replayEvent; // Next event to replay.
+static unsigned long replayed = 0; // Events replayed so far.
+static int loopStart = 0; // GLUT time at which the event loop started.
+static EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+static EGLContext eglContext = EGL_NO_CONTEXT;
+static unsigned int framebuffer, renderbuffers[2]; // Offscreen target.
+
+// Routine to return a clock reading in ms.
+static double readClock(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1.0e6;
+}
+
+// Routine to open an input log for recording or replay.
+static FILE *openLog(const char *name, int record)
+{
+    unsigned char header[8] = { 0 };
+    FILE *file = fopen(name, record ? "wb" : "rb");
+
+    if (file == NULL)
+    {
+        std::cerr << "harness: can't open input log \"" << name << "\"."
+                  << std::endl;
+        exit(1);
+    }
+
+    if (record)
+    {
+        memcpy(header, LOG_MAGIC, 4);
+        header[4] = LOG_VERSION;
+        fwrite(header, 1, sizeof(header), file);
+    }
+    else if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+             memcmp(header, LOG_MAGIC, 4) || header[4] != LOG_VERSION)
+    {
+        std::cerr << "harness: \"" << name << "\" is not an input log."
+                  << std::endl;
+        exit(1);
+    }
+    return file;
+}
+
+// Routine to append an event to the input log.
+static void writeEvent(const InputEvent &event)
+{
+    unsigned char record[LOG_RECORD_SIZE];
+
+    record[0] = event.time;
+    record[1] = event.time >> 8;
+    record[2] = event.time >> 16;
+    record[3] = event.time >> 24;
+    record[4] = event.type;
+    record[5] = event.code;
+    record[6] = event.state;
+    record[7] = 0;
+    record[8] = event.x;
+    record[9] = event.x >> 8;
+    record[10] = event.y;
+    record[11] = event.y >> 8;
+    fwrite(record, 1, LOG_RECORD_SIZE, recordFile);
+    fflush(recordFile); // Keep the log if the program is killed.
+}
+
+// Routine to read the next event from the replayed log; fails at the end.
+static int readEvent(InputEvent *event)
+{
+    unsigned char record[LOG_RECORD_SIZE];
+
+    if (fread(record, 1, LOG_RECORD_SIZE, replayFile) != LOG_RECORD_SIZE)
+        return 0;
+    event->time = record[0] | record[1] << 8 | record[2] << 16 |
+        (unsigned int)record[3] << 24;
+    event->type = record[4];
+    event->code = record[5];
+    event->state = record[6];
+    event->x = (short)(record[8] | record[9] << 8);
+    event->y = (short)(record[10] | record[11] << 8);
+    return 1;
+}
+
+// Routine to log an input event timestamped by the GLUT clock.
+static void recordEvent(int type, int code, int state, int x, int y)
+{
+    InputEvent event;
+
+    event.time = glutGet(GLUT_ELAPSED_TIME) - loopStart;
+    event.type = type;
+    event.code = code;
+    event.state = state;
+    event.x = x;
+    event.y = y;
+    writeEvent(event);
+}
+
+// Input callbacks used while recording: log, then pass on to the program.
+static void recordKeyboard(unsigned char key, int x, int y)
+{
+    recordEvent(EVENT_KEYBOARD, key, 0, x, y);
+    keyboardFunc(key, x, y);
+}
+
+static void recordSpecial(int key, int x, int y)
+{
+    recordEvent(EVENT_SPECIAL, key, 0, x, y);
+    specialFunc(key, x, y);
+}
+
+static void recordMouse(int button, int state, int x, int y)
+{
+    recordEvent(EVENT_MOUSE, button, state, x, y);
+    mouseFunc(button, state, x, y);
+}
+
+// Routine to return the time, in ms since the event loop started, at which
+// the next logged event is due.
+static double replayDue(void)
+{
+    return replayEvent.time / replaySpeed;
+}
+
+// Routine to feed the program every logged event due by time now, in ms
+// since the event loop started. Each is due at its logged time from the
+// start, so lateness in delivering one never delays those after it.
+static void replayEvents(double now)
+{
+    InputEvent event;
+
+    while (replayFile && replayDue() <= now)
+    {
+        event = replayEvent;
+        if (!readEvent(&replayEvent))
+        {
+            fclose(replayFile);
+            replayFile = NULL;
+            std::cout << "harness: replayed " << replayed + 1
+                      << " input events." << std::endl;
+        }
+        replayed++;
+
+        if (event.type == EVENT_KEYBOARD && keyboardFunc)
+            keyboardFunc(event.code, event.x, event.y);
+        else if (event.type == EVENT_SPECIAL && specialFunc)
+            specialFunc(event.code, event.x, event.y);
+        else if (event.type == EVENT_MOUSE && mouseFunc)
+            mouseFunc(event.code, event.state, event.x, event.y);
+    }
+}
+
+// GLUT timer routine that feeds the program the events now due and waits
+// for the next.
+static void replayNext(int value)
+{
+    double now = glutGet(GLUT_ELAPSED_TIME) - loopStart;
+
+    replayEvents(now);
+    if (replayFile)
+        glutTimerFunc((unsigned int)(replayDue() - now + 0.999), replayNext, 0);
+}
+
+// Routine to remove argument i and its n - 1 followers from argv.
+static void removeArguments(int *argcp, char **argv, int i, int n)
+{
+    int j;
+    for (j = i; j + n <= *argcp; j++) argv[j] = argv[j + n];
+    *argcp -= n;
+}
+
+void harnessInit(int *argcp, char **argv)
+{
+    int i = 1;
+
+    while (i < *argcp)
+    {
+        if (!strcmp(argv[i], "--headless"))
+        {
+            headless = 1;
+            removeArguments(argcp, argv, i, 1);
+        }
+        else if (!strcmp(argv[i], "--frames") && i + 1 < *argcp)
+        {
+            frames = atoi(argv[i + 1]);
+            removeArguments(argcp, argv, i, 2);
+        }
+        else if (!strcmp(argv[i], "--frame-time") && i + 1 < *argcp)
+        {
+            frameTime = atoi(argv[i + 1]);
+            removeArguments(argcp, argv, i, 2);
+        }
+        else if (!strcmp(argv[i], "--record") && i + 1 < *argcp)
+        {
+            recordFile = openLog(argv[i + 1], 1);
+            removeArguments(argcp, argv, i, 2);
+        }
+        else if (!strcmp(argv[i], "--replay") && i + 1 < *argcp)
+        {
+            replayFile = openLog(argv[i + 1], 0);
+            removeArguments(argcp, argv, i, 2);
+        }
+        else if (!strcmp(argv[i], "--replay-speed") && i + 1 < *argcp)
+        {
+            replaySpeed = atof(argv[i + 1]);
+            if (replaySpeed <= 0.0) replaySpeed = 1.0;
+            removeArguments(argcp, argv, i, 2);
+        }
+        else i++;
+    }
+
+    // There is nothing to record headless.
+    if (headless && recordFile)
+    {
+        fclose(recordFile);
+        recordFile = NULL;
+    }
+
+    if (!headless) glutInit(argcp, argv);
+}
+
+int harnessIsHeadless(void)
+{
+    return headless;
+}
+
+void harnessInitWindowSize(int width, int height)
+{
+    windowWidth = width;
+    windowHeight = height;
+    if (!headless) glutInitWindowSize(width, height);
+}
+
+// Exit routine to destroy the offscreen context. Being registered when the
+// context is created, it runs after any exit routines the program registers
+// later, which may still use the context.
+static void destroyOffscreenContext(void)
+{
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(2, renderbuffers);
+    eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(eglDisplay, eglContext);
+    eglTerminate(eglDisplay);
+}
+
+// Routine to create the surfaceless EGL context and the framebuffer object
+// that stands in for the window.
+static void createOffscreenContext(void)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (getPlatformDisplay)
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                        EGL_DEFAULT_DISPLAY, NULL);
+    if (eglDisplay == EGL_NO_DISPLAY)
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, NULL, NULL))
+    {
+        std::cerr << "harness: cannot initialize an EGL display." << std::endl;
+        exit(1);
+    }
+
+    // With no attributes Mesa returns its highest compatibility profile, so
+    // the fixed-function pipeline used by the programs is available.
+    eglBindAPI(EGL_OPENGL_API);
+    eglContext = eglCreateContext(eglDisplay, EGL_NO_CONFIG_KHR,
+                                  EGL_NO_CONTEXT, NULL);
+    if (eglContext == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+    {
+        std::cerr << "harness: cannot create a surfaceless OpenGL context."
+                  << std::endl;
+        exit(1);
+    }
+
+    atexit(destroyOffscreenContext);
+
+    glewExperimental = GL_TRUE;
+    glewInit();
+
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, windowWidth, windowHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8,
+                          windowWidth, windowHeight);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, renderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "harness: offscreen framebuffer is incomplete." << std::endl;
+        exit(1);
+    }
+
+    glViewport(0, 0, windowWidth, windowHeight);
+}
+
+int harnessCreateWindow(const char *title)
+{
+    if (!headless) return glutCreateWindow(title);
+
+    createOffscreenContext();
+    return 1;
+}
+
+void harnessDisplayFunc(void (*func)(void))
+{
+    displayFunc = func;
+    if (!headless) glutDisplayFunc(func);
+}
+
+void harnessReshapeFunc(void (*func)(int width, int height))
+{
+    reshapeFunc = func;
+    if (!headless) glutReshapeFunc(func);
+}
+
+// Input callbacks are kept for replay; when recording, GLUT calls them
+// through the logging routines.
+void harnessKeyboardFunc(void (*func)(unsigned char key, int x, int y))
+{
+    keyboardFunc = func;
+    if (!headless) glutKeyboardFunc(recordFile && func ? recordKeyboard : func);
+}
+
+void harnessSpecialFunc(void (*func)(int key, int x, int y))
+{
+    specialFunc = func;
+    if (!headless) glutSpecialFunc(recordFile && func ? recordSpecial : func);
+}
+
+void harnessMouseFunc(void (*func)(int button, int state, int x, int y))
+{
+    mouseFunc = func;
+    if (!headless) glutMouseFunc(recordFile && func ? recordMouse : func);
+}
+
+void harnessIdleFunc(void (*func)(void))
+{
+    idleFunc = func;
+    if (!headless) glutIdleFunc(func);
+}
+
+void harnessTimerFunc(unsigned int msecs, void (*func)(int value), int value)
+{
+    if (!headless)
+    {
+        glutTimerFunc(msecs, func, value);
+        return;
+    }
+
+    HarnessTimer timer = { syntheticTime + (long)msecs, func, value };
+    timers.push_back(timer);
+}
+
+// Headless, every frame is drawn anyway.
+void harnessPostRedisplay(void)
+{
+    if (!headless) glutPostRedisplay();
+}
+
+void harnessSwapBuffers(void)
+{
+    if (!headless) glutSwapBuffers();
+}
+
+// Headless, time is the synthetic clock.
+int harnessElapsedTime(void)
+{
+    if (headless) return syntheticTime;
+    return glutGet(GLUT_ELAPSED_TIME);
+}
+
+void harnessBitmapCharacter(void *font, int character)
+{
+    if (!headless) glutBitmapCharacter(font, character);
+}
+
+// Routine to run the timers due at the current synthetic time. Timers
+// registered by these callbacks wait at least until the next frame.
+static void runDueTimers(void)
+{
+    std::vector<HarnessTimer> due;
+    std::vector<HarnessTimer>::iterator timer;
+
+    for (timer = timers.begin(); timer != timers.end();)
+        if (timer->due <= syntheticTime)
+        {
+            due.push_back(*timer);
+            timer = timers.erase(timer);
+        }
+        else timer++;
+
+    for (timer = due.begin(); timer != due.end(); timer++)
+        timer->func(timer->value);
+}
+
+// Headless benchmark loop. Each frame is given the logged events due by its
+// synthetic time, however many. Replaying with no --frames given, it runs
+// until the log is exhausted.
+static void runHeadless(void)
+{
+    int i, untilReplayed = frames < 0 && replayFile;
+    double cpuStart, benchStart, cpu;
+    double cpuTotal = 0.0, cpuMin = 0.0, cpuMax = 0.0, wallTotal;
+
+    if (reshapeFunc) reshapeFunc(windowWidth, windowHeight);
+
+    benchStart = readClock(CLOCK_MONOTONIC);
+    if (frames < 0) frames = 100;
+    for (i = 0; untilReplayed ? replayFile != NULL : i < frames; i++)
+    {
+        cpuStart = readClock(CLOCK_PROCESS_CPUTIME_ID);
+
+        syntheticTime += frameTime;
+        replayEvents(syntheticTime);
+        runDueTimers();
+        if (idleFunc) idleFunc();
+        if (displayFunc) displayFunc();
+        glFinish(); // Charge the rendering to this frame.
+
+        cpu = readClock(CLOCK_PROCESS_CPUTIME_ID) - cpuStart;
+        cpuTotal += cpu;
+        if (i == 0 || cpu < cpuMin) cpuMin = cpu;
+        if (i == 0 || cpu > cpuMax) cpuMax = cpu;
+    }
+    wallTotal = readClock(CLOCK_MONOTONIC) - benchStart;
+    frames = i;
+
+    std::cout << "Headless: " << frames << " frames at " << windowWidth << "x"
+              << windowHeight << ", " << frameTime << " ms synthetic frame time."
+              << std::endl;
+    if (frames > 0)
+    {
+        std::cout << "CPU time per frame (ms): mean " << cpuTotal / frames
+                  << ", min " << cpuMin << ", max " << cpuMax << std::endl;
+        std::cout << "Throughput: " << frames * 1000.0 / wallTotal
+                  << " frames/s (" << wallTotal << " ms wall)." << std::endl;
+    }
+
+}
+
+void harnessMainLoop(void)
+{
+    if (replayFile && !readEvent(&replayEvent))
+    {
+        fclose(replayFile);
+        replayFile = NULL;
+    }
+
+    if (!headless)
+    {
+        loopStart = glutGet(GLUT_ELAPSED_TIME);
+        if (replayFile) glutTimerFunc((unsigned int)(replayDue() + 0.999),
+                                      replayNext, 0);
+        glutMainLoop();
+    }
+    else runHeadless();
+    exit(0);
+}
@@ -0,0 +1,77 @@
+/////////////////////////////////////////////////////////////////////////////
+// harness.h
+//
+// Thin layer over the GLUT window and callback routines that lets a program
+// run either normally, in a GLUT window, or headless for benchmarking.
+//
+// A program opts in by calling the harness routines below in place of the
+// GLUT routines of the same name (harnessInit() for glutInit(),
+// harnessPostRedisplay() for glutPostRedisplay(), and so on). Run normally,
+// each routine simply forwards to GLUT.
+//
+// Run with
+//
+//     ./prog42 --headless --frames N [--frame-time MS]
+//
+// and no window is opened. Instead an offscreen OpenGL context is created
+// with EGL (surfaceless, so llvmpipe works on nodes with no display or GPU)
+// and the program's own callbacks are driven for N frames by a synthetic
+// clock that advances MS milliseconds (default 16) per frame. Every frame
+// runs the timers that are due, the idle routine and the drawing routine,
+// after which the per-frame CPU time and the throughput are reported.
+//
+// Input can be recorded and replayed for reproducible runs. With
+//
+//     --record LOG
+//
+// every keyboard, special key and mouse event reaching the program is
+// timestamped and appended to the compact binary file LOG. With
+//
+//     --replay LOG [--replay-speed X]
+//
+// the logged events are fed back to the program's callbacks at their
+// original times from the start of the event loop, divided by X (default
+// 1). Replays work windowed or headless; headless, every event due by a
+// frame's synthetic time is delivered before the frame is drawn, and with
+// no --frames given, frames are drawn until the log is exhausted.
+//
+// Freeglut's shape and bitmap font routines need glutInit() and so cannot
+// be used headless; harnessBitmapCharacter() is a no-op there.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef HARNESS_H
+#define HARNESS_H
+
+// Routine to initialize the harness; strips its own options from argv and
+// calls glutInit() unless running headless.
+void harnessInit(int *argcp, char **argv);
+
+// Is the program running headless?
+int harnessIsHeadless(void);
+
+// Window creation.
+void harnessInitWindowSize(int width, int height);
+int harnessCreateWindow(const char *title);
+
+// Callback registration.
+void harnessDisplayFunc(void (*func)(void));
+void harnessReshapeFunc(void (*func)(int width, int height));
+void harnessKeyboardFunc(void (*func)(unsigned char key, int x, int y));
+void harnessSpecialFunc(void (*func)(int key, int x, int y));
+void harnessMouseFunc(void (*func)(int button, int state, int x, int y));
+void harnessIdleFunc(void (*func)(void));
+void harnessTimerFunc(unsigned int msecs, void (*func)(int value), int value);
+
+// Per-frame routines.
+void harnessPostRedisplay(void);
+void harnessSwapBuffers(void);
+void harnessBitmapCharacter(void *font, int character);
+
+// Routine to return glutGet(GLUT_ELAPSED_TIME), or headless the synthetic
+// clock, in ms.
+int harnessElapsedTime(void);
+
+// Routine to enter the event loop; does not return.
+void harnessMainLoop(void);
+
+#endif
@@ -0,0 +1,321 @@
+/////////////////////////////////////////////////////////////////////////////
+// immediate.cpp
+//
+// Implementation of the immediate-mode batching emulator declared in
+// immediate.h.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#define IMMEDIATE_IMPLEMENTATION
+#include "immediate.h"
+
+#define SEGMENTS 4 // Fenced segments in the ring buffer.
+#define SEGMENT_SIZE (1 << 20) // Bytes per segment.
+#define FENCE_TIMEOUT 1000000000 // ns to wait for a segment to come free.
+
+// One captured vertex with all its attributes.
+struct ImmediateVertex
+{
+    GLfloat position[3];
+    GLfloat color[4];
+    GLfloat normal[3];
+    GLfloat texCoord[2];
+    GLboolean edgeFlag;
+};
+
+// Globals.
+static int inPrimitive = 0; // Between immBegin() and immEnd()?
+static GLenum primitiveMode; // Mode passed to immBegin().
+static ImmediateVertex current = // Current attributes.
+    { { 0.0, 0.0, 0.0 }, { 1.0, 1.0, 1.0, 1.0 }, { 0.0, 0.0, 1.0 }, { 0.0, 0.0 },
+      GL_TRUE };
+static std::vector<ImmediateVertex> primitive; // Vertices of the open primitive.
+static std::vector<ImmediateVertex> batch; // Converted vertices awaiting a draw.
+static GLenum batchMode = GL_POINTS; // GL_POINTS, GL_LINES or GL_TRIANGLES.
+static int initialized = 0;
+static unsigned int buffer; // Vertex buffer object id.
+static char *mapped = NULL; // Persistent mapping of the whole ring, if any.
+static GLsync fences[SEGMENTS]; // Fence guarding each segment.
+static int segment = 0; // Segment being filled.
+static size_t head = 0; // Offset within the segment of the next write.
+
+// Routine to create the ring buffer, persistently mapped where
+// GL_ARB_buffer_storage is available and orphaned on each write otherwise.
+static void initialize(void)
+{
+    glGenBuffers(1, &buffer);
+    if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+    {
+        GLbitfield flags =
+            GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferStorage(GL_ARRAY_BUFFER, SEGMENTS * SEGMENT_SIZE, NULL, flags);
+        mapped = (char *)glMapBufferRange(GL_ARRAY_BUFFER, 0,
+                                          SEGMENTS * SEGMENT_SIZE, flags);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    initialized = 1;
+}
+
+// Routine to move to the next segment of the ring, fencing off the one just
+// filled and waiting for the GPU to finish reading the next one.
+static void nextSegment(void)
+{
+    fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    segment = (segment + 1) % SEGMENTS;
+    head = 0;
+    if (fences[segment])
+    {
+        while (glClientWaitSync(fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT,
+                                FENCE_TIMEOUT) == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(fences[segment]);
+        fences[segment] = 0;
+    }
+}
+
+// Routine to upload count vertices and draw them as mode.
+static void drawVertices(GLenum mode, const ImmediateVertex *vertices, size_t count)
+{
+    size_t bytes = count * sizeof(ImmediateVertex);
+    const char *base;
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (mapped)
+    {
+        if (head + bytes > SEGMENT_SIZE) nextSegment();
+        memcpy(mapped + segment * SEGMENT_SIZE + head, vertices, bytes);
+        base = (const char *)NULL + segment * SEGMENT_SIZE + head;
+        head += bytes;
+    }
+    else
+    {
+        glBufferData(GL_ARRAY_BUFFER, bytes, vertices, GL_STREAM_DRAW);
+        base = NULL;
+    }
+
+    glVertexPointer(3, GL_FLOAT, sizeof(ImmediateVertex),
+                    base + offsetof(ImmediateVertex, position));
+    glColorPointer(4, GL_FLOAT, sizeof(ImmediateVertex),
+                   base + offsetof(ImmediateVertex, color));
+    glNormalPointer(GL_FLOAT, sizeof(ImmediateVertex),
+                    base + offsetof(ImmediateVertex, normal));
+    glTexCoordPointer(2, GL_FLOAT, sizeof(ImmediateVertex),
+                      base + offsetof(ImmediateVertex, texCoord));
+    glEdgeFlagPointer(sizeof(ImmediateVertex),
+                      base + offsetof(ImmediateVertex, edgeFlag));
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_EDGE_FLAG_ARRAY);
+    glDrawArrays(mode, 0, (GLsizei)count);
+    glPopClientAttrib(); // Also restores the array buffer binding.
+}
+
+// Routine to append vertex to the batch with the given edge flag.
+static void emit(const ImmediateVertex &vertex, GLboolean edgeFlag)
+{
+    batch.push_back(vertex);
+    batch.back().edgeFlag = edgeFlag;
+}
+
+// Routine to append the triangle (a, b, c) with the edge flags of its edges
+// ab, bc and ca. The provoking vertex for flat shading is c.
+static void emitTriangle(const ImmediateVertex &a, const ImmediateVertex &b,
+                         const ImmediateVertex &c, GLboolean ab, GLboolean bc,
+                         GLboolean ca)
+{
+    emit(a, ab);
+    emit(b, bc);
+    emit(c, ca);
+}
+
+// Routine to append the open primitive to the batch as independent points,
+// lines or triangles, each keeping the provoking vertex GL would have used.
+static void convertPrimitive(void)
+{
+    std::vector<ImmediateVertex> &v = primitive;
+    size_t n = v.size(), i;
+
+    switch (primitiveMode)
+    {
+    case GL_POINTS:
+        for (i = 0; i < n; i++) emit(v[i], GL_TRUE);
+        break;
+    case GL_LINES:
+        for (i = 0; i + 1 < n; i += 2)
+        {
+            emit(v[i], GL_TRUE);
+            emit(v[i + 1], GL_TRUE);
+        }
+        break;
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        for (i = 0; i + 1 < n; i++)
+        {
+            emit(v[i], GL_TRUE);
+            emit(v[i + 1], GL_TRUE);
+        }
+        // Closing segment, provoked by the first vertex.
+        if (primitiveMode == GL_LINE_LOOP && n > 1)
+        {
+            emit(v[n - 1], GL_TRUE);
+            emit(v[0], GL_TRUE);
+        }
+        break;
+    case GL_TRIANGLES:
+        for (i = 0; i + 2 < n; i += 3)
+            emitTriangle(v[i], v[i + 1], v[i + 2], v[i].edgeFlag,
+                         v[i + 1].edgeFlag, v[i + 2].edgeFlag);
+        break;
+    case GL_TRIANGLE_STRIP:
+        // Odd triangles swap their first two vertices to keep the winding.
+        for (i = 0; i + 2 < n; i++)
+        {
+            if (i % 2 == 0) emitTriangle(v[i], v[i + 1], v[i + 2], 1, 1, 1);
+            else emitTriangle(v[i + 1], v[i], v[i + 2], 1, 1, 1);
+        }
+        break;
+    case GL_TRIANGLE_FAN:
+        for (i = 1; i + 1 < n; i++)
+            emitTriangle(v[0], v[i], v[i + 1], 1, 1, 1);
+        break;
+    case GL_QUADS:
+        // Split along bd so that both halves are provoked by d.
+        for (i = 0; i + 3 < n; i += 4)
+        {
+            emitTriangle(v[i], v[i + 1], v[i + 3], v[i].edgeFlag, GL_FALSE,
+                         v[i + 3].edgeFlag);
+            emitTriangle(v[i + 1], v[i + 2], v[i + 3], v[i + 1].edgeFlag,
+                         v[i + 2].edgeFlag, GL_FALSE);
+        }
+        break;
+    case GL_QUAD_STRIP:
+        // Quad i is (2i, 2i+1, 2i+3, 2i+2), provoked by 2i+3; split along
+        // the diagonal through that vertex.
+        for (i = 0; i + 3 < n; i += 2)
+        {
+            emitTriangle(v[i], v[i + 1], v[i + 3], 1, 1, 0);
+            emitTriangle(v[i + 2], v[i], v[i + 3], 1, 0, 1);
+        }
+        break;
+    case GL_POLYGON:
+        // Fan around the first vertex, which provokes the whole polygon.
+        for (i = 1; i + 1 < n; i++)
+            emitTriangle(v[i], v[i + 1], v[0], v[i].edgeFlag,
+                         i + 2 == n ? v[i + 1].edgeFlag : GL_FALSE,
+                         i == 1 ? v[0].edgeFlag : GL_FALSE);
+        break;
+    }
+}
+
+// Routine to return the independent primitive a mode is converted to.
+static GLenum batchModeOf(GLenum mode)
+{
+    switch (mode)
+    {
+    case GL_POINTS:
+        return GL_POINTS;
+    case GL_LINES:
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        return GL_LINES;
+    default:
+        return GL_TRIANGLES;
+    }
+}
+
+void immBegin(GLenum mode)
+{
+    if (inPrimitive) return;
+    if (batchModeOf(mode) != batchMode)
+    {
+        immFlush();
+        batchMode = batchModeOf(mode);
+    }
+    primitiveMode = mode;
+    primitive.clear();
+    inPrimitive = 1;
+}
+
+void immEnd(void)
+{
+    if (!inPrimitive) return;
+    convertPrimitive();
+    inPrimitive = 0;
+}
+
+void immVertex3f(GLfloat x, GLfloat y, GLfloat z)
+{
+    if (!inPrimitive) return;
+    current.position[0] = x;
+    current.position[1] = y;
+    current.position[2] = z;
+    primitive.push_back(current);
+}
+
+// Outside glBegin()/glEnd() the attribute routines also set GL's own current
+// value, which unbatched drawing such as the GLUT shapes relies on.
+void immColor4f(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+    current.color[0] = r;
+    current.color[1] = g;
+    current.color[2] = b;
+    current.color[3] = a;
+    if (!inPrimitive) glColor4f(r, g, b, a);
+}
+
+void immNormal3f(GLfloat x, GLfloat y, GLfloat z)
+{
+    current.normal[0] = x;
+    current.normal[1] = y;
+    current.normal[2] = z;
+    if (!inPrimitive) glNormal3f(x, y, z);
+}
+
+void immTexCoord2f(GLfloat s, GLfloat t)
+{
+    current.texCoord[0] = s;
+    current.texCoord[1] = t;
+    if (!inPrimitive) glTexCoord2f(s, t);
+}
+
+void immRectf(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2)
+{
+    if (inPrimitive) return;
+    immBegin(GL_POLYGON);
+    immVertex3f(x1, y1, 0.0);
+    immVertex3f(x2, y1, 0.0);
+    immVertex3f(x2, y2, 0.0);
+    immVertex3f(x1, y2, 0.0);
+    immEnd();
+}
+
+// Routine to draw the batch. Large batches are drawn a segment at a time,
+// split on primitive boundaries.
+void immFlush(void)
+{
+    size_t perPrimitive, perDraw, first, count;
+
+    if (batch.empty()) return;
+    if (!initialized) initialize();
+
+    perPrimitive = batchMode == GL_TRIANGLES ? 3 : batchMode == GL_LINES ? 2 : 1;
+    perDraw = SEGMENT_SIZE / sizeof(ImmediateVertex) / perPrimitive * perPrimitive;
+    for (first = 0; first < batch.size(); first += count)
+    {
+        count = batch.size() - first;
+        if (count > perDraw) count = perDraw;
+        drawVertices(batchMode, &batch[first], count);
+    }
+    batch.clear();
+
+    // Vertex arrays leave GL's current attributes undefined.
+    glColor4fv(current.color);
+    glNormal3fv(current.normal);
+    glTexCoord2fv(current.texCoord);
+}
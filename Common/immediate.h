@@ -0,0 +1,132 @@
+/////////////////////////////////////////////////////////////////////////////
+// immediate.h
+//
+// Immediate-mode batching emulator. A program switches to it by adding
+//
+//     #include "immediate.h"
+//
+// after its GL and GLUT includes and linking immediate.o; no other source
+// change is needed. glBegin()/glEnd()
+// sequences, and glRectf(), are then captured instead of being sent to
+// OpenGL vertex by vertex. Strips, fans, loops, quads and polygons are
+// turned into independent points, lines or triangles so that consecutive
+// primitives merge into one batch. A batch is drawn with a single
+// glDrawArrays() from a persistently mapped ring buffer as soon as anything
+// that could change how it is drawn happens: a state, matrix or raster
+// call, a switch between points, lines and triangles, or the end of the
+// frame.
+//
+// Flat shading and polygon modes are honoured: every triangle keeps the
+// provoking vertex of the primitive it came from, and edge flags hide the
+// diagonals added when quads and polygons are split. Line stipple restarts
+// at every segment of a converted line strip or loop.
+//
+// Only the GL, GLU and GLUT calls listed below flush the batch. Any other
+// call that depends on what has been drawn so far needs an explicit
+// immFlush() first.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef IMMEDIATE_H
+#define IMMEDIATE_H
+
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+#include "harness.h"
+
+// Emulator entry points.
+void immBegin(GLenum mode);
+void immEnd(void);
+void immVertex3f(GLfloat x, GLfloat y, GLfloat z);
+void immColor4f(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+void immNormal3f(GLfloat x, GLfloat y, GLfloat z);
+void immTexCoord2f(GLfloat s, GLfloat t);
+void immRectf(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2);
+void immFlush(void);
+
+#ifndef IMMEDIATE_IMPLEMENTATION
+
+// Captured calls.
+#define glBegin(mode) immBegin(mode)
+#define glEnd() immEnd()
+#define glVertex2f(x, y) immVertex3f(x, y, 0.0)
+#define glVertex2i(x, y) immVertex3f(x, y, 0.0)
+#define glVertex3f(x, y, z) immVertex3f(x, y, z)
+#define glVertex3d(x, y, z) immVertex3f(x, y, z)
+#define glVertex3fv(v) immVertex3f((v)[0], (v)[1], (v)[2])
+#define glColor3f(r, g, b) immColor4f(r, g, b, 1.0)
+#define glColor3fv(v) immColor4f((v)[0], (v)[1], (v)[2], 1.0)
+#define glColor3ub(r, g, b) immColor4f((r) / 255.0, (g) / 255.0, (b) / 255.0, 1.0)
+#define glColor3ubv(v) \
+    immColor4f((v)[0] / 255.0, (v)[1] / 255.0, (v)[2] / 255.0, 1.0)
+#define glColor4f(r, g, b, a) immColor4f(r, g, b, a)
+#define glColor4fv(v) immColor4f((v)[0], (v)[1], (v)[2], (v)[3])
+#define glNormal3f(x, y, z) immNormal3f(x, y, z)
+#define glNormal3fv(v) immNormal3f((v)[0], (v)[1], (v)[2])
+#define glTexCoord2f(s, t) immTexCoord2f(s, t)
+#define glTexCoord2d(s, t) immTexCoord2f(s, t)
+#define glRectf(x1, y1, x2, y2) immRectf(x1, y1, x2, y2)
+
+// Calls that flush the batch first.
+#define IMM_FLUSHED(call) (immFlush(), call)
+#define glPushMatrix() IMM_FLUSHED(glPushMatrix())
+#define glPopMatrix() IMM_FLUSHED(glPopMatrix())
+#define glLoadIdentity() IMM_FLUSHED(glLoadIdentity())
+#define glMatrixMode(...) IMM_FLUSHED(glMatrixMode(__VA_ARGS__))
+#define glTranslatef(...) IMM_FLUSHED(glTranslatef(__VA_ARGS__))
+#define glRotatef(...) IMM_FLUSHED(glRotatef(__VA_ARGS__))
+#define glScalef(...) IMM_FLUSHED(glScalef(__VA_ARGS__))
+#define glMultMatrixf(...) IMM_FLUSHED(glMultMatrixf(__VA_ARGS__))
+#define glLoadMatrixf(...) IMM_FLUSHED(glLoadMatrixf(__VA_ARGS__))
+#define glFrustum(...) IMM_FLUSHED(glFrustum(__VA_ARGS__))
+#define glOrtho(...) IMM_FLUSHED(glOrtho(__VA_ARGS__))
+#define glViewport(...) IMM_FLUSHED(glViewport(__VA_ARGS__))
+#define glEnable(...) IMM_FLUSHED(glEnable(__VA_ARGS__))
+#define glDisable(...) IMM_FLUSHED(glDisable(__VA_ARGS__))
+#define glPolygonMode(...) IMM_FLUSHED(glPolygonMode(__VA_ARGS__))
+#define glLineWidth(...) IMM_FLUSHED(glLineWidth(__VA_ARGS__))
+#define glPointSize(...) IMM_FLUSHED(glPointSize(__VA_ARGS__))
+#define glLineStipple(...) IMM_FLUSHED(glLineStipple(__VA_ARGS__))
+#define glShadeModel(...) IMM_FLUSHED(glShadeModel(__VA_ARGS__))
+#define glCullFace(...) IMM_FLUSHED(glCullFace(__VA_ARGS__))
+#define glFrontFace(...) IMM_FLUSHED(glFrontFace(__VA_ARGS__))
+#define glDepthFunc(...) IMM_FLUSHED(glDepthFunc(__VA_ARGS__))
+#define glClear(...) IMM_FLUSHED(glClear(__VA_ARGS__))
+#define glLightf(...) IMM_FLUSHED(glLightf(__VA_ARGS__))
+#define glLightfv(...) IMM_FLUSHED(glLightfv(__VA_ARGS__))
+#define glLightModeli(...) IMM_FLUSHED(glLightModeli(__VA_ARGS__))
+#define glLightModelfv(...) IMM_FLUSHED(glLightModelfv(__VA_ARGS__))
+#define glMaterialfv(...) IMM_FLUSHED(glMaterialfv(__VA_ARGS__))
+#define glColorMaterial(...) IMM_FLUSHED(glColorMaterial(__VA_ARGS__))
+#define glBindTexture(...) IMM_FLUSHED(glBindTexture(__VA_ARGS__))
+#define glTexEnvf(...) IMM_FLUSHED(glTexEnvf(__VA_ARGS__))
+#define glTexGeni(...) IMM_FLUSHED(glTexGeni(__VA_ARGS__))
+#define glTexParameteri(...) IMM_FLUSHED(glTexParameteri(__VA_ARGS__))
+#define glRasterPos3f(...) IMM_FLUSHED(glRasterPos3f(__VA_ARGS__))
+#define glCallList(...) IMM_FLUSHED(glCallList(__VA_ARGS__))
+#define glCallLists(...) IMM_FLUSHED(glCallLists(__VA_ARGS__))
+#define glNewList(...) IMM_FLUSHED(glNewList(__VA_ARGS__))
+#define glEndList() IMM_FLUSHED(glEndList())
+#define glDrawArrays(...) IMM_FLUSHED(glDrawArrays(__VA_ARGS__))
+#define glDrawElements(...) IMM_FLUSHED(glDrawElements(__VA_ARGS__))
+#define glReadPixels(...) IMM_FLUSHED(glReadPixels(__VA_ARGS__))
+#define glFlush() IMM_FLUSHED(glFlush())
+#define glFinish() IMM_FLUSHED(glFinish())
+#define gluLookAt(...) IMM_FLUSHED(gluLookAt(__VA_ARGS__))
+#define gluPerspective(...) IMM_FLUSHED(gluPerspective(__VA_ARGS__))
+#define glutSwapBuffers() IMM_FLUSHED(glutSwapBuffers())
+#define glutBitmapCharacter(...) IMM_FLUSHED(glutBitmapCharacter(__VA_ARGS__))
+#define glutWireSphere(...) IMM_FLUSHED(glutWireSphere(__VA_ARGS__))
+#define glutSolidSphere(...) IMM_FLUSHED(glutSolidSphere(__VA_ARGS__))
+#define glutWireCube(...) IMM_FLUSHED(glutWireCube(__VA_ARGS__))
+#define glutSolidCube(...) IMM_FLUSHED(glutSolidCube(__VA_ARGS__))
+#define glutWireCone(...) IMM_FLUSHED(glutWireCone(__VA_ARGS__))
+#define glutSolidCone(...) IMM_FLUSHED(glutSolidCone(__VA_ARGS__))
+#define glutWireTorus(...) IMM_FLUSHED(glutWireTorus(__VA_ARGS__))
+#define glutSolidTorus(...) IMM_FLUSHED(glutSolidTorus(__VA_ARGS__))
+#define harnessSwapBuffers() IMM_FLUSHED(harnessSwapBuffers())
+#define harnessBitmapCharacter(...) IMM_FLUSHED(harnessBitmapCharacter(__VA_ARGS__))
+
+#endif
+
+#endif
@@ -0,0 +1,399 @@
+/////////////////////////////////////////////////////////////////////////////
+// keyframeClip.cpp
+//
+// Implementation of the keyframe clips declared in keyframeClip.h.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "workerPool.h"
+#include "keyframeClip.h"
+
+// On-disk header, see keyframeClip.h.
+struct ClipHeader
+{
+    char magic[8];
+    uint32_t version, headerSize, frameFloats, blockFrames;
+    uint64_t frameCount;
+    uint32_t byteOrder, angleSteps, moveSteps;
+    uint32_t reserved[5];
+};
+
+static_assert(sizeof(ClipHeader) == 64, "clip header must be 64 bytes");
+
+static const char magic[8] = "MANCLIP";
+static const uint32_t byteOrder = 0x01020304;
+
+#define ANGLE_CHANNELS 9
+#define ANGLE_STEPS 65520 // 182 a degree.
+#define PADDING 64 // Zero bytes after the last block; a frame is at most 55.
+
+// Routine to append v to out as a varint.
+static void putVarint(std::vector<unsigned char> &out, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back(v | 0x80);
+        v >>= 7;
+    }
+    out.push_back(v);
+}
+
+// Routine to read a varint of at most 5 bytes at p into v; returns the byte
+// after it.
+static inline const unsigned char *getVarint(const unsigned char *p, uint32_t &v)
+{
+    unsigned char byte;
+    int shift = 0;
+
+    // One and two bytes, the most common by far, straight off.
+    if (p[0] < 0x80)
+    {
+        v = p[0];
+        return p + 1;
+    }
+    if (p[1] < 0x80)
+    {
+        v = (p[0] & 0x7F) | (uint32_t)p[1] << 7;
+        return p + 2;
+    }
+    v = 0;
+    do
+    {
+        byte = *p++;
+        v |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && shift < 35);
+    return p;
+}
+
+// Routine to write to q the quantized channels of frame.
+static void quantize(const float *frame, uint32_t *q)
+{
+    int k;
+
+    for (k = 0; k < ANGLE_CHANNELS; k++)
+    {
+        long step = lround(frame[k] * (ANGLE_STEPS / 360.0)) % ANGLE_STEPS;
+        q[k] = step < 0 ? step + ANGLE_STEPS : step;
+    }
+    for (; k < KEYFRAME_FLOATS; k++)
+        q[k] = (uint32_t)lround(frame[k] * KEYFRAME_CLIP_MOVE_STEPS);
+}
+
+// Routine to return the number of blocks of a clip.
+static size_t blockCount(size_t count, size_t blockFrames)
+{
+    return (count + blockFrames - 1) / blockFrames;
+}
+
+size_t keyframeClipWrite(const char *path, const float *frames, size_t count)
+{
+    size_t blocks = blockCount(count, KEYFRAME_CLIP_BLOCK), i, done;
+    std::vector<unsigned char> out;
+    uint32_t q[KEYFRAME_FLOATS], last[KEYFRAME_FLOATS];
+    ClipHeader header;
+    uint64_t offset;
+    int fd, k;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = KEYFRAME_CLIP_VERSION;
+    header.headerSize = sizeof(header);
+    header.frameFloats = KEYFRAME_FLOATS;
+    header.blockFrames = KEYFRAME_CLIP_BLOCK;
+    header.frameCount = count;
+    header.byteOrder = byteOrder;
+    header.angleSteps = ANGLE_STEPS;
+    header.moveSteps = KEYFRAME_CLIP_MOVE_STEPS;
+
+    // Header and room for the block table, filled in as the blocks go.
+    out.resize(sizeof(header) + (blocks + 1) * sizeof(uint64_t));
+    memcpy(&out[0], &header, sizeof(header));
+    for (i = 0; i < count; i++)
+    {
+        if (i % KEYFRAME_CLIP_BLOCK == 0)
+        {
+            offset = out.size();
+            memcpy(&out[sizeof(header) + i / KEYFRAME_CLIP_BLOCK * sizeof(offset)],
+                   &offset, sizeof(offset));
+            memset(last, 0, sizeof(last));
+        }
+        quantize(frames + KEYFRAME_STRIDE * i, q);
+        for (k = 0; k < KEYFRAME_FLOATS; k++)
+        {
+            // Angle differences wrap round into [-ANGLE_STEPS / 2,
+            // ANGLE_STEPS / 2), move differences at 32 bits.
+            int32_t d = q[k] - last[k];
+            if (k < ANGLE_CHANNELS)
+            {
+                if (d >= ANGLE_STEPS / 2) d -= ANGLE_STEPS;
+                else if (d < -ANGLE_STEPS / 2) d += ANGLE_STEPS;
+            }
+            putVarint(out, ((uint32_t)d << 1) ^ (uint32_t)(d >> 31));
+            last[k] = q[k];
+        }
+    }
+    offset = out.size();
+    memcpy(&out[sizeof(header) + blocks * sizeof(offset)], &offset, sizeof(offset));
+    out.resize(out.size() + PADDING, 0);
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    for (done = 0; fd >= 0 && done < out.size(); )
+    {
+        ssize_t n = write(fd, &out[done], out.size() - done);
+        if (n < 0 && errno != EINTR) break;
+        if (n > 0) done += n;
+    }
+    if (fd < 0 || done < out.size() || close(fd) < 0)
+    {
+        std::cerr << path << ": " << strerror(errno) << std::endl;
+        if (fd >= 0 && done < out.size()) close(fd);
+        return 0;
+    }
+    return out.size();
+}
+
+int keyframeClipOpen(const char *path, KeyframeClip &clip)
+{
+    struct stat status;
+    ClipHeader header;
+    const char *problem = NULL;
+    size_t blocks = 0, tableEnd = 0, b;
+    void *map;
+    int fd;
+
+    keyframeClipClose(clip);
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &status) < 0)
+    {
+        std::cerr << path << ": " << strerror(errno) << std::endl;
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    if ((size_t)status.st_size < sizeof(header) + PADDING)
+    {
+        std::cerr << path << ": not a keyframe clip" << std::endl;
+        close(fd);
+        return 0;
+    }
+    map = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file.
+    if (map == MAP_FAILED)
+    {
+        std::cerr << path << ": " << strerror(errno) << std::endl;
+        return 0;
+    }
+
+    memcpy(&header, map, sizeof(header));
+    if (memcmp(header.magic, magic, sizeof(magic)))
+        problem = "not a keyframe clip";
+    else if (header.byteOrder != byteOrder)
+        problem = "written with the other byte order";
+    else if (header.version != KEYFRAME_CLIP_VERSION)
+        problem = "unsupported version";
+    else if (header.frameFloats != KEYFRAME_FLOATS || header.blockFrames == 0 ||
+             header.angleSteps != ANGLE_STEPS || header.moveSteps == 0 ||
+             header.headerSize < sizeof(header) || header.headerSize % 8)
+        problem = "unsupported clip layout";
+    else
+    {
+        // The block table, and the blocks it points to, must lie in the file.
+        blocks = blockCount(header.frameCount, header.blockFrames);
+        tableEnd = header.headerSize + (blocks + 1) * sizeof(uint64_t);
+        if (tableEnd + PADDING > (size_t)status.st_size)
+            problem = "truncated";
+    }
+    if (!problem)
+    {
+        const uint64_t *offsets =
+            (const uint64_t *)((const char *)map + header.headerSize);
+        for (b = 0; b <= blocks && !problem; b++)
+            if (offsets[b] < (b ? offsets[b - 1] : tableEnd) ||
+                offsets[b] > (uint64_t)status.st_size - PADDING)
+                problem = "corrupt block table";
+        clip.blockOffsets = offsets;
+    }
+    if (problem)
+    {
+        std::cerr << path << ": " << problem << std::endl;
+        munmap(map, status.st_size);
+        clip.blockOffsets = NULL;
+        return 0;
+    }
+
+    clip.map = map;
+    clip.mapLength = status.st_size;
+    clip.count = header.frameCount;
+    clip.blockFrames = header.blockFrames;
+    clip.angleSteps = ANGLE_STEPS / 360;
+    clip.moveSteps = header.moveSteps;
+    return 1;
+}
+
+void keyframeClipClose(KeyframeClip &clip)
+{
+    if (clip.map) munmap(clip.map, clip.mapLength);
+    clip.map = NULL;
+    clip.mapLength = 0;
+    clip.blockOffsets = NULL;
+    clip.count = clip.blockFrames = 0;
+    clip.decodedBlock[0] = clip.decodedBlock[1] = -1;
+}
+
+void keyframeClipDecode(const KeyframeClip &clip, size_t block, float *frames)
+{
+    const unsigned char *base = (const unsigned char *)clip.map;
+    const unsigned char *p = base + clip.blockOffsets[block];
+    const unsigned char *end = base + clip.blockOffsets[block + 1];
+    size_t first = block * clip.blockFrames, i;
+    size_t n = std::min(clip.blockFrames, clip.count - first);
+    uint32_t v[KEYFRAME_STRIDE] = { 0 };
+    int k;
+
+#ifdef __SSE2__
+    // Lanes of the three vectors of a frame: 9 angles, 2 moves and the
+    // padding float, which stays zero. Angle sums wrap round at
+    // ANGLE_STEPS; dividing by the steps per degree or unit rather than
+    // multiplying by a step gives back exactly the floats written wherever
+    // those were the nearest floats to whole steps.
+    const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi32(1);
+    const __m128i turn = _mm_set1_epi32(ANGLE_STEPS);
+    const __m128i lastTurn = _mm_set_epi32(0, 0, 0, ANGLE_STEPS);
+    const __m128i paddingMask = _mm_set_epi32(0, -1, -1, -1);
+    const __m128 angleSteps = _mm_set1_ps(clip.angleSteps);
+    const __m128 lastSteps = _mm_set_ps(1.0, clip.moveSteps, clip.moveSteps,
+                                        clip.angleSteps);
+    __m128i sum[3] = { zero, zero, zero }, d[3];
+
+    for (i = 0; i < n; i++)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+        float *frame = frames + KEYFRAME_STRIDE * i;
+
+        if (p < end && !(_mm_movemask_epi8(bytes) & 0x7FF))
+        {
+            // All 11 differences are one byte: widen bytes 0 to 10 at once.
+            __m128i low = _mm_unpacklo_epi8(bytes, zero);
+            __m128i high = _mm_unpackhi_epi8(bytes, zero);
+            d[0] = _mm_unpacklo_epi16(low, zero);
+            d[1] = _mm_unpackhi_epi16(low, zero);
+            d[2] = _mm_and_si128(_mm_unpacklo_epi16(high, zero), paddingMask);
+            p += KEYFRAME_FLOATS;
+        }
+        else
+        {
+            // A block running past its end is corrupt: its last values hold.
+            for (k = 0; k < KEYFRAME_FLOATS; k++)
+                if (p < end) p = getVarint(p, v[k]);
+                else v[k] = 0;
+            for (k = 0; k < 3; k++)
+                d[k] = _mm_loadu_si128((const __m128i *)(v + 4 * k));
+        }
+
+        for (k = 0; k < 3; k++)
+        {
+            const __m128i &wrap = k < 2 ? turn : lastTurn;
+
+            // Undo the zigzag, (d >> 1) ^ -(d & 1), add to the sums and
+            // bring the angles back into [0, ANGLE_STEPS).
+            sum[k] = _mm_add_epi32(sum[k], _mm_xor_si128(_mm_srli_epi32(d[k], 1),
+                     _mm_sub_epi32(zero, _mm_and_si128(d[k], one))));
+            sum[k] = _mm_sub_epi32(sum[k], _mm_and_si128(wrap,
+                     _mm_cmpgt_epi32(sum[k], _mm_sub_epi32(turn, one))));
+            sum[k] = _mm_add_epi32(sum[k], _mm_and_si128(wrap,
+                     _mm_cmplt_epi32(sum[k], zero)));
+            _mm_storeu_ps(frame + 4 * k, _mm_div_ps(_mm_cvtepi32_ps(sum[k]),
+                                                    k < 2 ? angleSteps : lastSteps));
+        }
+    }
+#else
+    int32_t sum[KEYFRAME_FLOATS] = { 0 };
+
+    for (i = 0; i < n; i++)
+    {
+        float *frame = frames + KEYFRAME_STRIDE * i;
+
+        for (k = 0; k < KEYFRAME_FLOATS; k++)
+        {
+            if (p < end) p = getVarint(p, v[k]);
+            else v[k] = 0;
+            sum[k] += (v[k] >> 1) ^ (0 - (v[k] & 1));
+        }
+        for (k = 0; k < ANGLE_CHANNELS; k++)
+        {
+            if (sum[k] >= ANGLE_STEPS) sum[k] -= ANGLE_STEPS;
+            else if (sum[k] < 0) sum[k] += ANGLE_STEPS;
+            frame[k] = (float)sum[k] / clip.angleSteps;
+        }
+        for (; k < KEYFRAME_FLOATS; k++) frame[k] = (float)sum[k] / clip.moveSteps;
+        frame[KEYFRAME_FLOATS] = 0.0;
+    }
+#endif
+}
+
+void keyframeClipRead(const KeyframeClip &clip, KeyframeSet &set)
+{
+    keyframesClose(set);
+    set.storage.resize(KEYFRAME_STRIDE * clip.count);
+    workerPoolFor(blockCount(clip.count, clip.blockFrames), 16,
+                  [&](size_t first, size_t last)
+    {
+        size_t b;
+        for (b = first; b < last; b++)
+            keyframeClipDecode(clip, b, &set.storage[KEYFRAME_STRIDE * b *
+                                                     clip.blockFrames]);
+    });
+    set.frames = set.storage.data();
+    set.count = clip.count;
+}
+
+// Routine to return frame i of clip, decoding its block if not decoded.
+static const float *clipFrame(KeyframeClip &clip, size_t i)
+{
+    long block = i / clip.blockFrames;
+    int slot;
+
+    if (clip.decodedBlock[0] == block) slot = 0;
+    else if (clip.decodedBlock[1] == block) slot = 1;
+    else
+    {
+        slot = 1 - clip.lastUsed;
+        clip.decoded[slot].resize(KEYFRAME_STRIDE * clip.blockFrames);
+        keyframeClipDecode(clip, block, &clip.decoded[slot][0]);
+        clip.decodedBlock[slot] = block;
+    }
+    clip.lastUsed = slot;
+    return &clip.decoded[slot][KEYFRAME_STRIDE * (i % clip.blockFrames)];
+}
+
+void keyframeClipPose(KeyframeClip &clip, double t, float *pose)
+{
+    float pair[2 * KEYFRAME_STRIDE];
+    const float *frame;
+    size_t i;
+
+    if (clip.count == 0) return;
+
+    // The frames either side of t, then keyframesPose() between them.
+    t -= floor(t / clip.count) * clip.count;
+    i = std::min((size_t)t, clip.count - 1);
+    frame = clipFrame(clip, i);
+    std::copy(frame, frame + KEYFRAME_STRIDE, pair);
+    frame = clipFrame(clip, i + 1 < clip.count ? i + 1 : i);
+    std::copy(frame, frame + KEYFRAME_STRIDE, pair + KEYFRAME_STRIDE);
+    keyframesPose(pair, 2, t - i, pose);
+}
@@ -0,0 +1,104 @@
+/////////////////////////////////////////////////////////////////////////////
+// keyframeClip.h
+//
+// Compressed keyframe clips of the AnimateMan programs, for archives of
+// animation too big to keep as the 48-byte frames of keyframes.h.
+//
+// Values are quantized: part angles, which lie in [0, 360), to 16 bits, in
+// steps of 1/182 degree (65520 a turn), and the moves to steps of
+// 1/moveSteps (100). Values come back within half a step; the editor's
+// 5-degree angles come back exactly. Its moves need not: they are sums of
+// 0.1 steps in floating point, which drift off the hundredths (15.1000214,
+// say), and come back snapped to the nearest hundredth (15.1000004). Each
+// channel is then stored as the difference from its value in the frame
+// before, zigzag-encoded so small negative differences are small numbers
+// too, as a varint: 7 bits a byte, low bits first, the high bit set on all
+// but the last byte. Angle differences wrap round, so 355 to 5 degrees is a
+// small step. An unchanged channel costs one byte, a 5-degree turn two.
+//
+// Frames are grouped in blocks of blockFrames (64), the first frame of a
+// block coded against zero, so any block decodes on its own. The format
+// (version 1) is a 64-byte header,
+//
+//     magic        8 bytes  "MANCLIP" and a NUL
+//     version      uint32   KEYFRAME_CLIP_VERSION
+//     headerSize   uint32   offset of the block table
+//     frameFloats  uint32   channels per frame, 11
+//     blockFrames  uint32   frames per block
+//     frameCount   uint64   number of frames
+//     byteOrder    uint32   0x01020304 as written by the writing machine
+//     angleSteps   uint32   65520, steps of a turn
+//     moveSteps    uint32   steps of a unit move
+//     reserved     20 bytes zero
+//
+// then a table of blockCount + 1 uint64 file offsets, where block b runs
+// from offset b to offset b + 1, then the blocks and 64 bytes of zero
+// padding, so the decoder may read ahead of a block without checking.
+//
+// keyframeClipOpen() maps a clip, checking only its header and table.
+// Blocks are decoded on demand: keyframeClipPose() plays a clip, decoding
+// the blocks of the frames either side of the time asked for, and keeps
+// the last two decoded, so playing decodes each block once. Where a frame's
+// differences all fit a byte, as while the man holds still, the decoder
+// widens and decodes all of them at once with SSE2; the running sums and
+// the scaling back to floats are done four channels at a time with SSE2
+// for every frame. keyframeClipRead() decodes a whole clip on the worker pool (see
+// workerPool.h). Programs linking keyframeClip.o also link keyframes.o and
+// workerPool.o and need -pthread.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef KEYFRAME_CLIP_H
+#define KEYFRAME_CLIP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "keyframes.h"
+
+#define KEYFRAME_CLIP_VERSION 1
+#define KEYFRAME_CLIP_BLOCK 64 // Frames per block written.
+#define KEYFRAME_CLIP_MOVE_STEPS 100 // Steps per unit move written.
+
+// A clip mapped from a file, and the blocks last decoded from it.
+struct KeyframeClip
+{
+    size_t count = 0; // Frames.
+    size_t blockFrames = 0;
+    float angleSteps = 0.0, moveSteps = 0.0; // Steps per degree and unit.
+
+    void *map = NULL; // Mapping of the file.
+    size_t mapLength = 0;
+    const uint64_t *blockOffsets = NULL; // Into the mapping.
+
+    // Two blocks decoded, stride KEYFRAME_STRIDE, and which they are (-1 for
+    // none); the least recently used is decoded over next.
+    std::vector<float> decoded[2];
+    long decodedBlock[2] = { -1, -1 };
+    int lastUsed = 0;
+};
+
+// Routine to write the count frames at frames (laid out with
+// KEYFRAME_STRIDE) to a clip file at path. Returns the size of the file in
+// bytes, else writes why to std::cerr and returns 0.
+size_t keyframeClipWrite(const char *path, const float *frames, size_t count);
+
+// Routine to map the clip file at path into clip, replacing any clip there.
+// Returns 1 on success, else writes why to std::cerr and returns 0.
+int keyframeClipOpen(const char *path, KeyframeClip &clip);
+
+// Routine to release clip, leaving it empty.
+void keyframeClipClose(KeyframeClip &clip);
+
+// Routine to decode block of clip to frames, laid out with KEYFRAME_STRIDE;
+// the last block may hold fewer than blockFrames frames. Thread-safe.
+void keyframeClipDecode(const KeyframeClip &clip, size_t block, float *frames);
+
+// Routine to decode all of clip into set, replacing any frames there.
+void keyframeClipRead(const KeyframeClip &clip, KeyframeSet &set);
+
+// Routine to write to pose the configuration of clip at time t, as
+// keyframesPose() does for frames in memory.
+void keyframeClipPose(KeyframeClip &clip, double t, float *pose);
+
+#endif
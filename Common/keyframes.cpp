@@ -0,0 +1,467 @@
+/////////////////////////////////////////////////////////////////////////////
+// keyframes.cpp
+//
+// Implementation of the keyframe files declared in keyframes.h.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "keyframes.h"
+
+// On-disk header, see keyframes.h.
+struct KeyframeHeader
+{
+    char magic[8];
+    uint32_t version, headerSize, frameFloats, frameStride;
+    uint64_t frameCount;
+    uint32_t byteOrder;
+    uint32_t reserved[7];
+};
+
+static_assert(sizeof(KeyframeHeader) == 64, "keyframe header must be 64 bytes");
+
+static const char magic[8] = "MANKEYS";
+static const uint32_t byteOrder = 0x01020304;
+static const size_t frameBytes = KEYFRAME_STRIDE * sizeof(float);
+
+// Text files are parsed in chunks of at least CHUNK_BYTES, one per thread.
+// At most MAX_ERRORS malformed lines are reported, and then the count.
+#define CHUNK_BYTES (1 << 20)
+#define MAX_ERRORS 10
+
+// A chunk of a text file: whole lines, from begin to end, numbered from
+// firstLine, whose frames go to the store from frame firstFrame on.
+struct TextChunk
+{
+    const char *begin, *end;
+    size_t lines, frames, firstLine, firstFrame;
+    std::vector<std::pair<size_t, std::string> > errors; // Line and message.
+    size_t errorCount;
+};
+
+// Routine to return a header for count frames as this machine writes them.
+static KeyframeHeader makeHeader(uint64_t count)
+{
+    KeyframeHeader header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = KEYFRAME_VERSION;
+    header.headerSize = sizeof(KeyframeHeader);
+    header.frameFloats = KEYFRAME_FLOATS;
+    header.frameStride = frameBytes;
+    header.frameCount = count;
+    header.byteOrder = byteOrder;
+    return header;
+}
+
+// Routine to check that a file of length bytes starting with header is one
+// this machine can map; writes why not to std::cerr.
+static int checkHeader(const char *path, const KeyframeHeader &header,
+                       size_t length)
+{
+    const char *problem = NULL;
+
+    if (length < sizeof(header) || memcmp(header.magic, magic, sizeof(magic)))
+        problem = "not a keyframe file";
+    else if (header.byteOrder != byteOrder)
+        problem = "written with the other byte order";
+    else if (header.version != KEYFRAME_VERSION)
+        problem = "unsupported version";
+    else if (header.frameFloats != KEYFRAME_FLOATS ||
+             header.frameStride != frameBytes ||
+             header.headerSize < sizeof(header) || header.headerSize % 16)
+        problem = "unsupported frame layout";
+    else if (header.frameCount > (length - header.headerSize) / frameBytes)
+        problem = "truncated";
+
+    if (problem)
+    {
+        std::cerr << path << ": " << problem << std::endl;
+        return 0;
+    }
+    return 1;
+}
+
+// Routine to write size bytes at offset in full.
+static int writeAll(int fd, const void *data, size_t size, off_t offset)
+{
+    const char *bytes = (const char *)data;
+
+    while (size > 0)
+    {
+        ssize_t done = pwrite(fd, bytes, size, offset);
+        if (done < 0)
+        {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        bytes += done;
+        offset += done;
+        size -= done;
+    }
+    return 1;
+}
+
+int keyframesOpen(const char *path, KeyframeSet &set)
+{
+    struct stat status;
+    KeyframeHeader header;
+    void *map;
+    int fd;
+
+    keyframesClose(set);
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &status) < 0)
+    {
+        std::cerr << path << ": " << strerror(errno) << std::endl;
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    if ((size_t)status.st_size < sizeof(header))
+    {
+        std::cerr << path << ": not a keyframe file" << std::endl;
+        close(fd);
+        return 0;
+    }
+
+    map = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file.
+    if (map == MAP_FAILED)
+    {
+        std::cerr << path << ": " << strerror(errno) << std::endl;
+        return 0;
+    }
+    memcpy(&header, map, sizeof(header));
+    if (!checkHeader(path, header, status.st_size))
+    {
+        munmap(map, status.st_size);
+        return 0;
+    }
+    madvise(map, status.st_size, MADV_SEQUENTIAL);
+
+    set.map = map;
+    set.mapLength = status.st_size;
+    set.frames = (const float *)((const char *)map + header.headerSize);
+    set.count = header.frameCount;
+    return 1;
+}
+
+// Routine to return if the characters from begin to end are all white space.
+static int isBlank(const char *begin, const char *end)
+{
+    for (; begin < end; begin++)
+        if (!isspace((unsigned char)*begin)) return 0;
+    return 1;
+}
+
+// Routine to count the lines of a chunk and those of them that are frames,
+// i.e. not blank.
+static void countLines(TextChunk &chunk)
+{
+    const char *line, *end;
+
+    chunk.lines = chunk.frames = 0;
+    for (line = chunk.begin; line < chunk.end; line = end + 1)
+    {
+        end = (const char *)memchr(line, '\n', chunk.end - line);
+        if (!end) end = chunk.end;
+        chunk.lines++;
+        if (!isBlank(line, end)) chunk.frames++;
+    }
+}
+
+// Routine to note a malformed line of a chunk, keeping the first few.
+static void addError(TextChunk &chunk, size_t line, const std::string &message)
+{
+    if (chunk.errors.size() < MAX_ERRORS)
+        chunk.errors.push_back(std::make_pair(line, message));
+    chunk.errorCount++;
+}
+
+// Routine to parse the frames of a chunk into frames, from its first frame
+// on. A frame line holds KEYFRAME_FLOATS numbers and nothing else.
+static void parseLines(TextChunk &chunk, float *frames)
+{
+    const char *line, *end, *p;
+    size_t lineNumber = chunk.firstLine;
+    float *frame = frames + KEYFRAME_STRIDE * chunk.firstFrame;
+    int i;
+
+    for (line = chunk.begin; line < chunk.end; line = end + 1, lineNumber++)
+    {
+        end = (const char *)memchr(line, '\n', chunk.end - line);
+        if (!end) end = chunk.end;
+        if (isBlank(line, end)) continue;
+
+        p = line;
+        for (i = 0; i < KEYFRAME_FLOATS; i++)
+        {
+            std::from_chars_result result;
+
+            while (p < end && isspace((unsigned char)*p)) p++;
+            if (p < end && *p == '+') p++; // Accepted by operator>>, not from_chars().
+            result = std::from_chars(p, end, frame[i]);
+            if (result.ec != std::errc()) break;
+            p = result.ptr;
+        }
+        if (i < KEYFRAME_FLOATS)
+            addError(chunk, lineNumber, p == end || isspace((unsigned char)*p) ?
+                     "expected " + std::to_string(KEYFRAME_FLOATS) + " numbers" :
+                     "bad number");
+        else if (!isBlank(p, end))
+            addError(chunk, lineNumber, "text after " +
+                     std::to_string(KEYFRAME_FLOATS) + " numbers");
+        frame[KEYFRAME_FLOATS] = 0.0;
+        frame += KEYFRAME_STRIDE;
+    }
+}
+
+// Routine to run work on every chunk, each on its own thread.
+template <class Work>
+static void forEachChunk(std::vector<TextChunk> &chunks, Work work)
+{
+    std::vector<std::thread> threads;
+    size_t c;
+
+    for (c = 1; c < chunks.size(); c++)
+        threads.push_back(std::thread(work, std::ref(chunks[c])));
+    work(chunks[0]);
+    for (c = 0; c < threads.size(); c++) threads[c].join();
+}
+
+int keyframesReadText(const char *path, KeyframeSet &set)
+{
+    struct stat status;
+    std::vector<TextChunk> chunks;
+    const char *text = NULL, *begin, *end;
+    size_t length, threads, c, lines = 0, frames = 0, errors = 0;
+    void *map = NULL;
+    int fd;
+
+    keyframesClose(set);
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &status) < 0)
+    {
+        std::cerr << path << ": " << strerror(errno) << std::endl;
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    length = status.st_size;
+    if (length > 0)
+    {
+        map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            std::cerr << path << ": " << strerror(errno) << std::endl;
+            close(fd);
+            return 0;
+        }
+        madvise(map, length, MADV_SEQUENTIAL);
+        text = (const char *)map;
+    }
+    close(fd);
+
+    // Split the text into one chunk per thread, but none much under
+    // CHUNK_BYTES, each ending just after a newline.
+    threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max((size_t)1, std::min(threads, length / CHUNK_BYTES));
+    for (begin = text, c = 1; c <= threads; c++, begin = end)
+    {
+        TextChunk chunk{};
+
+        end = c == threads ? text + length : text + length * c / threads;
+        if (end < begin) end = begin;
+        while (end < text + length && end > text && end[-1] != '\n') end++;
+        chunk.begin = begin;
+        chunk.end = end;
+        chunk.errorCount = 0;
+        chunks.push_back(chunk);
+    }
+
+    // Count the frames of each chunk, give each chunk its place in the
+    // store, then parse every chunk straight into its place.
+    forEachChunk(chunks, countLines);
+    for (c = 0; c < chunks.size(); c++)
+    {
+        chunks[c].firstLine = lines + 1;
+        chunks[c].firstFrame = frames;
+        lines += chunks[c].lines;
+        frames += chunks[c].frames;
+    }
+    set.storage.resize(KEYFRAME_STRIDE * frames);
+    forEachChunk(chunks, [&set](TextChunk &chunk)
+                 { parseLines(chunk, set.storage.data()); });
+    if (map) munmap(map, length);
+
+    for (c = 0; c < chunks.size(); c++)
+    {
+        std::vector<std::pair<size_t, std::string> >::iterator error;
+        for (error = chunks[c].errors.begin(); error != chunks[c].errors.end() &&
+             errors < MAX_ERRORS; error++, errors++)
+            std::cerr << path << ":" << error->first << ": " << error->second
+                      << std::endl;
+        errors += chunks[c].errorCount - (error - chunks[c].errors.begin());
+    }
+    if (errors > 0)
+    {
+        std::cerr << path << ": " << errors << " malformed line"
+                  << (errors > 1 ? "s" : "") << std::endl;
+        keyframesClose(set);
+        return 0;
+    }
+
+    set.frames = set.storage.empty() ? NULL : &set.storage[0];
+    set.count = frames;
+    return 1;
+}
+
+void keyframesClose(KeyframeSet &set)
+{
+    if (set.map) munmap(set.map, set.mapLength);
+    set.map = NULL;
+    set.mapLength = 0;
+    std::vector<float>().swap(set.storage);
+    set.frames = NULL;
+    set.count = 0;
+}
+
+void keyframesPose(const float *frames, size_t count, double t, float *pose)
+{
+    const float *a, *b;
+    double cycles = floor(t / count);
+    size_t i;
+    float s, d;
+    int k;
+
+    // Frames a and b either side of t, and how far t is from a to b.
+    t -= cycles * count;
+    i = std::min((size_t)t, count - 1);
+    s = t - i;
+    a = frames + KEYFRAME_STRIDE * i;
+    b = i + 1 < count ? a + KEYFRAME_STRIDE : a;
+
+    for (k = 0; k < 9; k++)
+    {
+        d = b[k] - a[k];
+        d -= 360.0 * floor((d + 180.0) / 360.0); // Into [-180, 180).
+        pose[k] = a[k] + s * d;
+        if (pose[k] < 0.0) pose[k] += 360.0;
+        else if (pose[k] >= 360.0) pose[k] -= 360.0;
+    }
+    for (; k < KEYFRAME_FLOATS; k++) pose[k] = a[k] + s * (b[k] - a[k]);
+}
+
+int keyframeWriterOpen(KeyframeWriter &writer, const char *path)
+{
+    KeyframeSet existing;
+    struct stat status;
+    KeyframeHeader header;
+    size_t headerSize;
+
+    writer.written.clear();
+    writer.fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (writer.fd < 0 || fstat(writer.fd, &status) < 0)
+    {
+        std::cerr << path << ": " << strerror(errno) << std::endl;
+        keyframeWriterClose(writer);
+        return 0;
+    }
+
+    // Keep the frames of a valid file, else start it afresh. Frames are
+    // written after a header of this version's size, so those of a file
+    // with a longer header are moved up to it.
+    if (status.st_size > 0 && keyframesOpen(path, existing))
+    {
+        writer.written.assign(existing.frames,
+                              existing.frames + KEYFRAME_STRIDE * existing.count);
+        headerSize = (const char *)existing.frames - (const char *)existing.map;
+        header = makeHeader(existing.count);
+        keyframesClose(existing);
+        if (headerSize == sizeof(header)) return 1;
+    }
+    else header = makeHeader(0);
+
+    if (ftruncate(writer.fd, 0) < 0 ||
+        !writeAll(writer.fd, &header, sizeof(header), 0) ||
+        !writeAll(writer.fd, writer.written.data(),
+                  writer.written.size() * sizeof(float), sizeof(header)))
+    {
+        std::cerr << path << ": " << strerror(errno) << std::endl;
+        keyframeWriterClose(writer);
+        return 0;
+    }
+    return 1;
+}
+
+long keyframeWriterSync(KeyframeWriter &writer, const float *frames,
+                        size_t count)
+{
+    size_t old = writer.written.size() / KEYFRAME_STRIDE, i, first;
+    long changed = 0;
+    KeyframeHeader header;
+
+    if (writer.fd < 0) return -1;
+
+    // Copy the new and changed frames into written, then write each run of
+    // them with one call. Frames go to disk before the header that counts
+    // them, so a reader never counts an appended frame before it is
+    // written; but changed frames are overwritten in place, so a reader
+    // mapping the file meanwhile may see one half written.
+    writer.written.resize(KEYFRAME_STRIDE * count, 0.0);
+    for (i = 0; i < count; i = first)
+    {
+        for (first = i; first < count &&
+             first < old &&
+             !memcmp(&writer.written[KEYFRAME_STRIDE * first],
+                     &frames[KEYFRAME_STRIDE * first],
+                     KEYFRAME_FLOATS * sizeof(float));
+             first++);
+        if (first == count) break;
+
+        for (i = first; i < count &&
+             (i >= old || memcmp(&writer.written[KEYFRAME_STRIDE * i],
+                                 &frames[KEYFRAME_STRIDE * i],
+                                 KEYFRAME_FLOATS * sizeof(float)));
+             i++)
+            memcpy(&writer.written[KEYFRAME_STRIDE * i],
+                   &frames[KEYFRAME_STRIDE * i], KEYFRAME_FLOATS * sizeof(float));
+
+        if (!writeAll(writer.fd, &writer.written[KEYFRAME_STRIDE * first],
+                      (i - first) * frameBytes,
+                      sizeof(header) + first * frameBytes))
+            return -1;
+        changed += i - first;
+        first = i;
+    }
+
+    header = makeHeader(count);
+    if (!writeAll(writer.fd, &header, sizeof(header), 0)) return -1;
+    if (count < old && ftruncate(writer.fd, sizeof(header) + count * frameBytes) < 0)
+        return -1;
+    return changed;
+}
+
+void keyframeWriterClose(KeyframeWriter &writer)
+{
+    if (writer.fd >= 0) close(writer.fd);
+    writer.fd = -1;
+    std::vector<float>().swap(writer.written);
+}
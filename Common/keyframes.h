@@ -0,0 +1,111 @@
+/////////////////////////////////////////////////////////////////////////////
+// keyframes.h
+//
+// Keyframe files of the AnimateMan programs. A keyframe is one configuration
+// of the man: the angles of his 9 body parts followed by upMove and
+// forwardMove, 11 floats in all.
+//
+// The binary format (version 1) is a 64-byte header,
+//
+//     magic        8 bytes  "MANKEYS" and a NUL
+//     version      uint32   KEYFRAME_VERSION
+//     headerSize   uint32   offset of the first frame, a multiple of 16
+//     frameFloats  uint32   floats used per frame, 11
+//     frameStride  uint32   bytes per frame, a multiple of 16 (48)
+//     frameCount   uint64   number of frames
+//     byteOrder    uint32   0x01020304 as written by the writing machine
+//     reserved     28 bytes zero
+//
+// followed by frameCount frames of frameStride bytes each, so every frame
+// starts 16-byte aligned. Bytes past the last counted frame are ignored,
+// which lets a writer append frames first and count them after.
+//
+// keyframesOpen() maps a binary file read-only and points straight into the
+// mapping: loading costs no parse and no copy whatever the number of frames.
+// keyframesReadText() reads the older text format (one frame per line, 11
+// numbers separated by white space; blank lines are skipped) into memory
+// laid out the same way, so callers need not care where the frames came
+// from. The file is mapped and split at line boundaries into one chunk per
+// hardware thread; each thread counts the frames of its chunk, then, the
+// store allocated once for all of them, parses its chunk straight into its
+// part of the store with std::from_chars(). Malformed lines are reported
+// with their line numbers and fail the read. Programs linking keyframes.o
+// need -pthread.
+//
+// keyframesPose() evaluates the configuration at any time between frames,
+// for playback at display rate rather than one frame per timer tick.
+//
+// A KeyframeWriter keeps a binary file in step with an editor's frames:
+// each keyframeWriterSync() writes only the frames that are new or have
+// changed since the last, then the header. A sync is not atomic: changed
+// frames are rewritten in place, and a program mapping the file during one
+// may see them half written.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef KEYFRAMES_H
+#define KEYFRAMES_H
+
+#include <cstddef>
+#include <vector>
+
+#define KEYFRAME_VERSION 1
+#define KEYFRAME_FLOATS 11 // Floats used per frame.
+#define KEYFRAME_STRIDE 12 // Floats per frame in memory and on disk.
+
+// A set of frames, mapped from a binary file or read from a text file.
+// Frame i is frames[KEYFRAME_STRIDE * i] to
+// frames[KEYFRAME_STRIDE * i + KEYFRAME_FLOATS - 1].
+struct KeyframeSet
+{
+    const float *frames = NULL;
+    size_t count = 0;
+
+    void *map = NULL; // Mapping of a binary file, if any.
+    size_t mapLength = 0;
+    std::vector<float> storage; // Frames read from a text file, if any.
+};
+
+// Routines to load the frames of the file at path into set, replacing any
+// already there; each returns 1 on success, else writes why to std::cerr
+// and returns 0.
+int keyframesOpen(const char *path, KeyframeSet &set);
+int keyframesReadText(const char *path, KeyframeSet &set);
+
+// Routine to release the frames of set, leaving it empty.
+void keyframesClose(KeyframeSet &set);
+
+// Routine to write to pose the KEYFRAME_FLOATS values of the configuration
+// at time t, counted in frames from the first of the count frames at frames
+// (laid out with KEYFRAME_STRIDE) and looping every count frames. Between
+// frames i and i + 1 the part angles turn the short way round, so 355 to 5
+// passes 0, and the moves are blended linearly. The last frame is held
+// until the loop restarts. As frames are evenly spaced in time, finding
+// them is a division whatever the time or count, so scrubbing costs no
+// more than playing.
+void keyframesPose(const float *frames, size_t count, double t, float *pose);
+
+// Writer of a binary keyframe file; see keyframeWriterSync().
+struct KeyframeWriter
+{
+    int fd = -1; // -1 if not open.
+    std::vector<float> written; // The frames in the file, stride as above.
+};
+
+// Routine to open the binary file at path for writing, creating it if
+// needed. Frames already in a valid file are kept and count as written
+// (moved up behind a 64-byte header if the file's is longer); anything else
+// in the file is discarded.
+// Returns 1 on success, else writes why to std::cerr and returns 0.
+int keyframeWriterOpen(KeyframeWriter &writer, const char *path);
+
+// Routine to make the file hold exactly the count frames at frames, laid
+// out with KEYFRAME_STRIDE. Frames equal to those already written are left
+// alone, changed ones are overwritten in place, new ones appended and any
+// beyond count cut off. Returns the number of frames written or -1 on
+// error.
+long keyframeWriterSync(KeyframeWriter &writer, const float *frames,
+                        size_t count);
+
+void keyframeWriterClose(KeyframeWriter &writer);
+
+#endif
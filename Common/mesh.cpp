@@ -0,0 +1,353 @@
+/////////////////////////////////////////////////////////////////////////////
+// mesh.cpp
+//
+// Implementation of the parametric meshes declared in mesh.h.
+/////////////////////////////////////////////////////////////////////////////
+
+#define _USE_MATH_DEFINES
+
+#include <cmath>
+
+#include "mesh.h"
+
+#define VERTICES 0 // Vertex buffer id.
+#define INDICES 1 // Indexes buffer id.
+#define RESTART_INDICES 2 // Restart-joined indexes buffer id.
+#define RESTART 0xFFFFFFFF // Primitive restart index.
+#define STRIDE (6 * sizeof(float)) // Bytes per interleaved vertex.
+
+// Routine to fill c and s with the cosines and sines of the n + 1 angles
+// evenly spaced from start to end.
+static void fillAngleTable(float start, float end, int n, std::vector<float> &c,
+                           std::vector<float> &s)
+{
+    int k;
+    c.resize(n + 1);
+    s.resize(n + 1);
+    for (k = 0; k <= n; k++)
+    {
+        c[k] = cos(start + (end - start) * k / n);
+        s[k] = sin(start + (end - start) * k / n);
+    }
+}
+
+// Routine to append a vertex with position (x, y, z) and normal
+// (nx, ny, nz).
+static void addVertex(std::vector<float> &vertices, float x, float y, float z,
+                      float nx, float ny, float nz)
+{
+    vertices.push_back(x);
+    vertices.push_back(y);
+    vertices.push_back(z);
+    vertices.push_back(nx);
+    vertices.push_back(ny);
+    vertices.push_back(nz);
+}
+
+// Routine to upload the vertex and index arrays and fill in the strip
+// offsets of the mesh, whose counts are already set.
+static void upload(Mesh &mesh, const std::vector<float> &vertices,
+                   const std::vector<unsigned int> &indices)
+{
+    std::vector<unsigned int> joined;
+    size_t k, offset = 0;
+
+    glGenBuffers(3, mesh.buffers);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.buffers[VERTICES]);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float),
+                 &vertices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.buffers[INDICES]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+                 &indices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    mesh.offsets.resize(mesh.counts.size());
+    for (k = 0; k < mesh.counts.size(); k++)
+    {
+        mesh.offsets[k] = (const void *)(offset * sizeof(unsigned int));
+        if (k > 0) joined.push_back(RESTART);
+        joined.insert(joined.end(), indices.begin() + offset,
+                      indices.begin() + offset + mesh.counts[k]);
+        offset += mesh.counts[k];
+    }
+
+    mesh.restartCount = joined.size();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.buffers[RESTART_INDICES]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, joined.size() * sizeof(unsigned int),
+                 &joined[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+// Routine to return a mesh over a grid of (rows + 1) x (columns + 1)
+// vertices, stored row by row, with one triangle strip per row.
+static Mesh gridMesh(int rows, int columns, const std::vector<float> &vertices)
+{
+    Mesh mesh;
+    std::vector<unsigned int> indices;
+    int i, j;
+
+    mesh.mode = GL_TRIANGLE_STRIP;
+    for (j = 0; j < rows; j++)
+    {
+        for (i = 0; i <= columns; i++)
+        {
+            indices.push_back((j + 1) * (columns + 1) + i);
+            indices.push_back(j * (columns + 1) + i);
+        }
+        mesh.counts.push_back(2 * (columns + 1));
+    }
+    upload(mesh, vertices, indices);
+    return mesh;
+}
+
+// Routine to return line strips over a grid of (rows + 1) x (columns + 1)
+// vertices, stored row by row: one along each row from firstRow to lastRow
+// and one across the rows at each column but the last.
+static Mesh wireGridMesh(int rows, int columns, int firstRow, int lastRow,
+                         const std::vector<float> &vertices)
+{
+    Mesh mesh;
+    std::vector<unsigned int> indices;
+    int i, j;
+
+    mesh.mode = GL_LINE_STRIP;
+    for (j = firstRow; j <= lastRow; j++)
+    {
+        for (i = 0; i <= columns; i++) indices.push_back(j * (columns + 1) + i);
+        mesh.counts.push_back(columns + 1);
+    }
+    for (i = 0; i < columns; i++)
+    {
+        for (j = 0; j <= rows; j++) indices.push_back(j * (columns + 1) + i);
+        mesh.counts.push_back(rows + 1);
+    }
+    upload(mesh, vertices, indices);
+    return mesh;
+}
+
+// Routine to fill vertices with the grid of a sphere about the z-axis, rows
+// running from the south pole to the north.
+static void fillSphereGrid(float radius, int slices, int stacks,
+                           std::vector<float> &vertices)
+{
+    std::vector<float> cosSlice, sinSlice, cosStack, sinStack;
+    int i, j;
+
+    fillAngleTable(0.0, 2.0 * M_PI, slices, cosSlice, sinSlice);
+    fillAngleTable(-M_PI / 2.0, M_PI / 2.0, stacks, cosStack, sinStack);
+    for (j = 0; j <= stacks; j++)
+        for (i = 0; i <= slices; i++)
+        {
+            float nx = cosStack[j] * cosSlice[i];
+            float ny = cosStack[j] * sinSlice[i];
+            float nz = sinStack[j];
+            addVertex(vertices, radius * nx, radius * ny, radius * nz, nx, ny, nz);
+        }
+}
+
+// Routine to fill vertices with the grid of a cone, rows running from the
+// base to the apex.
+static void fillConeGrid(float radius, float height, int slices, int stacks,
+                         std::vector<float> &vertices)
+{
+    std::vector<float> cosSlice, sinSlice;
+    float length = sqrt(radius * radius + height * height);
+    int i, j;
+
+    fillAngleTable(0.0, 2.0 * M_PI, slices, cosSlice, sinSlice);
+    for (j = 0; j <= stacks; j++)
+        for (i = 0; i <= slices; i++)
+        {
+            float r = radius * (stacks - j) / stacks;
+            addVertex(vertices, r * cosSlice[i], r * sinSlice[i],
+                      height * j / stacks, height / length * cosSlice[i],
+                      height / length * sinSlice[i], radius / length);
+        }
+}
+
+Mesh meshPartialSphere(float radius, int longSlices, int latSlices,
+                       float longStart, float longEnd, float latStart,
+                       float latEnd)
+{
+    std::vector<float> vertices, cosLong, sinLong, cosLat, sinLat;
+    int i, j;
+
+    fillAngleTable(longStart, longEnd, longSlices, cosLong, sinLong);
+    fillAngleTable(latStart, latEnd, latSlices, cosLat, sinLat);
+    for (j = 0; j <= latSlices; j++)
+        for (i = 0; i <= longSlices; i++)
+        {
+            float nx = cosLat[j] * cosLong[i];
+            float ny = sinLat[j];
+            float nz = -cosLat[j] * sinLong[i];
+            addVertex(vertices, radius * nx, radius * ny, radius * nz, nx, ny, nz);
+        }
+    return gridMesh(latSlices, longSlices, vertices);
+}
+
+Mesh meshHemisphere(float radius, int longSlices, int latSlices)
+{
+    return meshPartialSphere(radius, longSlices, latSlices, 0.0, 2.0 * M_PI,
+                             0.0, M_PI / 2.0);
+}
+
+Mesh meshSphere(float radius, int slices, int stacks)
+{
+    std::vector<float> vertices;
+    fillSphereGrid(radius, slices, stacks, vertices);
+    return gridMesh(stacks, slices, vertices);
+}
+
+// The poles are single points and get no circle.
+Mesh meshWireSphere(float radius, int slices, int stacks)
+{
+    std::vector<float> vertices;
+    fillSphereGrid(radius, slices, stacks, vertices);
+    return wireGridMesh(stacks, slices, 1, stacks - 1, vertices);
+}
+
+void meshWireSphereLines(float radius, int slices, int stacks,
+                         std::vector<float> &positions,
+                         std::vector<unsigned int> &lines)
+{
+    std::vector<float> vertices;
+    unsigned int first = positions.size() / 3;
+    size_t k;
+    int i, j;
+
+    fillSphereGrid(radius, slices, stacks, vertices);
+    for (k = 0; k < vertices.size(); k += 6)
+        positions.insert(positions.end(), &vertices[k], &vertices[k] + 3);
+
+    // The lines of the strips of wireGridMesh(stacks, slices, 1, stacks - 1).
+    for (j = 1; j < stacks; j++)
+        for (i = 0; i < slices; i++)
+        {
+            lines.push_back(first + j * (slices + 1) + i);
+            lines.push_back(first + j * (slices + 1) + i + 1);
+        }
+    for (i = 0; i < slices; i++)
+        for (j = 0; j < stacks; j++)
+        {
+            lines.push_back(first + j * (slices + 1) + i);
+            lines.push_back(first + (j + 1) * (slices + 1) + i);
+        }
+}
+
+Mesh meshTorus(float ringRadius, float tubeRadius, int ringSlices,
+               int tubeSlices)
+{
+    std::vector<float> vertices, cosRing, sinRing, cosTube, sinTube;
+    int i, j;
+
+    fillAngleTable(0.0, 2.0 * M_PI, ringSlices, cosRing, sinRing);
+    fillAngleTable(0.0, 2.0 * M_PI, tubeSlices, cosTube, sinTube);
+    for (j = 0; j <= tubeSlices; j++)
+        for (i = 0; i <= ringSlices; i++)
+        {
+            float r = ringRadius + tubeRadius * cosTube[j];
+            addVertex(vertices, r * cosRing[i], r * sinRing[i],
+                      tubeRadius * sinTube[j], cosTube[j] * cosRing[i],
+                      cosTube[j] * sinRing[i], sinTube[j]);
+        }
+    return gridMesh(tubeSlices, ringSlices, vertices);
+}
+
+Mesh meshCone(float radius, float height, int slices, int stacks)
+{
+    std::vector<float> vertices;
+    fillConeGrid(radius, height, slices, stacks, vertices);
+    return gridMesh(stacks, slices, vertices);
+}
+
+// The apex row is a single point and gets no circle.
+Mesh meshWireCone(float radius, float height, int slices, int stacks)
+{
+    std::vector<float> vertices;
+    fillConeGrid(radius, height, slices, stacks, vertices);
+    return wireGridMesh(stacks, slices, 0, stacks - 1, vertices);
+}
+
+Mesh meshDisc(float radius, int slices)
+{
+    return meshAnnulus(0.0, radius, slices, 1);
+}
+
+Mesh meshAnnulus(float innerRadius, float outerRadius, int slices, int rings)
+{
+    std::vector<float> vertices, cosSlice, sinSlice;
+    int i, j;
+
+    // Rows run inwards so that the strips face the positive z-axis.
+    fillAngleTable(0.0, 2.0 * M_PI, slices, cosSlice, sinSlice);
+    for (j = 0; j <= rings; j++)
+        for (i = 0; i <= slices; i++)
+        {
+            float r = outerRadius - (outerRadius - innerRadius) * j / rings;
+            addVertex(vertices, r * cosSlice[i], r * sinSlice[i], 0.0, 0.0, 0.0,
+                      1.0);
+        }
+    return gridMesh(rings, slices, vertices);
+}
+
+Mesh meshHelix(float radius, float pitch, float turns, int samplesPerTurn)
+{
+    Mesh mesh;
+    std::vector<float> vertices, cosSample, sinSample;
+    std::vector<unsigned int> indices;
+    int samples = (int)ceil(turns * samplesPerTurn), k;
+
+    // One turn's table serves every turn.
+    fillAngleTable(0.0, 2.0 * M_PI, samplesPerTurn, cosSample, sinSample);
+    for (k = 0; k <= samples; k++)
+    {
+        int i = k % samplesPerTurn;
+        addVertex(vertices, radius * cosSample[i], radius * sinSample[i],
+                  pitch * k / samplesPerTurn, cosSample[i], sinSample[i], 0.0);
+        indices.push_back(k);
+    }
+
+    mesh.mode = GL_LINE_STRIP;
+    mesh.counts.push_back(samples + 1);
+    upload(mesh, vertices, indices);
+    return mesh;
+}
+
+void meshDraw(const Mesh &mesh)
+{
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.buffers[VERTICES]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.buffers[INDICES]);
+    glVertexPointer(3, GL_FLOAT, STRIDE, 0);
+    glNormalPointer(GL_FLOAT, STRIDE, (const void *)(3 * sizeof(float)));
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glMultiDrawElements(mesh.mode, &mesh.counts[0], GL_UNSIGNED_INT,
+                        (const void **)&mesh.offsets[0], mesh.counts.size());
+    glPopClientAttrib(); // Also restores the buffer bindings.
+}
+
+void meshDrawInstanced(const Mesh &mesh, int instances)
+{
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.buffers[VERTICES]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.buffers[RESTART_INDICES]);
+    glVertexPointer(3, GL_FLOAT, STRIDE, 0);
+    glNormalPointer(GL_FLOAT, STRIDE, (const void *)(3 * sizeof(float)));
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(RESTART);
+    glDrawElementsInstanced(mesh.mode, mesh.restartCount, GL_UNSIGNED_INT, 0,
+                            instances);
+    glDisable(GL_PRIMITIVE_RESTART);
+    glPopClientAttrib();
+}
+
+void meshDelete(Mesh &mesh)
+{
+    glDeleteBuffers(3, mesh.buffers);
+    mesh.counts.clear();
+    mesh.offsets.clear();
+}
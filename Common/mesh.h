@@ -0,0 +1,94 @@
+/////////////////////////////////////////////////////////////////////////////
+// mesh.h
+//
+// Parametric surface meshes built once and kept in buffer objects. Each
+// generator samples its surface on a grid, storing interleaved position and
+// normal per vertex, and indexes the grid as one triangle strip per row in
+// the manner of hemisphereMultidrawVBO.cpp; the strips are then drawn with a
+// single glMultiDrawElements(). The helix, a curve, is a single line strip,
+// and the wire meshes are sets of line strips along the grid lines.
+//
+// The sines and cosines are tabulated once per row and once per column, so a
+// p x q grid costs O(p + q) trigonometric evaluations rather than O(p * q).
+//
+// Angles are in radians. Strip vertices alternate between row j + 1 and row
+// j, as in the drawing loop of hemisphere.cpp, so the outside of each
+// surface is front-facing.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef MESH_H
+#define MESH_H
+
+#include <vector>
+
+#include <GL/glew.h>
+
+// A mesh resident in buffer objects.
+struct Mesh
+{
+    GLenum mode; // GL_TRIANGLE_STRIP or GL_LINE_STRIP.
+    unsigned int buffers[3]; // Vertex, index and restart index buffer ids.
+    std::vector<GLsizei> counts; // Index count of each strip.
+    std::vector<const void *> offsets; // Index buffer offset of each strip.
+    GLsizei restartCount; // Indices, all strips joined by restart indices.
+};
+
+// Routine to return the part of the sphere of the given radius between
+// longitudes longStart and longEnd and latitudes latStart and latEnd, the
+// y-axis being the polar axis.
+Mesh meshPartialSphere(float radius, int longSlices, int latSlices,
+                       float longStart, float longEnd, float latStart,
+                       float latEnd);
+
+// Routine to return the northern hemisphere of hemisphere.cpp.
+Mesh meshHemisphere(float radius, int longSlices, int latSlices);
+
+// Routine to return a sphere about the z-axis, as glutSolidSphere() draws it.
+Mesh meshSphere(float radius, int slices, int stacks);
+
+// Routine to return the circles of latitude and longitude that
+// glutWireSphere() draws.
+Mesh meshWireSphere(float radius, int slices, int stacks);
+
+// Routine to append the lines of meshWireSphere() to positions (x, y, z per
+// vertex) and lines (two indices into positions per line), for callers that
+// transform the vertices themselves.
+void meshWireSphereLines(float radius, int slices, int stacks,
+                         std::vector<float> &positions,
+                         std::vector<unsigned int> &lines);
+
+// Routine to return a torus about the z-axis, with ringRadius from the axis
+// to the center of the tube.
+Mesh meshTorus(float ringRadius, float tubeRadius, int ringSlices,
+               int tubeSlices);
+
+// Routine to return a cone with base in the z = 0 plane and apex on the
+// positive z-axis, as glutSolidCone() draws it.
+Mesh meshCone(float radius, float height, int slices, int stacks);
+
+// Routine to return the circles and lines that glutWireCone() draws.
+Mesh meshWireCone(float radius, float height, int slices, int stacks);
+
+// Routine to return a disc in the z = 0 plane, facing the positive z-axis.
+Mesh meshDisc(float radius, int slices);
+
+// Routine to return an annulus in the z = 0 plane, facing the positive
+// z-axis.
+Mesh meshAnnulus(float innerRadius, float outerRadius, int slices, int rings);
+
+// Routine to return a helix about the z-axis rising pitch per turn; its
+// normals point away from the axis.
+Mesh meshHelix(float radius, float pitch, float turns, int samplesPerTurn);
+
+// Routine to draw a mesh with the current color and material.
+void meshDraw(const Mesh &mesh);
+
+// Routine to draw instances copies of a mesh with one glDrawElementsInstanced()
+// call, the strips being joined by primitive restart (OpenGL 3.1). The caller
+// sets up the per-instance attributes and the program that applies them.
+void meshDrawInstanced(const Mesh &mesh, int instances);
+
+// Routine to delete a mesh's buffer objects.
+void meshDelete(Mesh &mesh);
+
+#endif
@@ -0,0 +1,104 @@
+/////////////////////////////////////////////////////////////////////////////
+// shapeCache.cpp
+//
+// Implementation of the cached shapes declared in shapeCache.h.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <map>
+
+#include "shapeCache.h"
+
+// Cached shapes.
+enum Shape { WIRE_SPHERE, SOLID_SPHERE, WIRE_CONE, SOLID_CONE, CONE_BASE };
+
+// Cache key: a shape at unit size and its tessellation.
+struct ShapeKey
+{
+    Shape shape;
+    int slices, stacks;
+    bool operator<(const ShapeKey &other) const
+    {
+        if (shape != other.shape) return shape < other.shape;
+        if (slices != other.slices) return slices < other.slices;
+        return stacks < other.stacks;
+    }
+};
+
+// Globals.
+static std::map<ShapeKey, Mesh> meshes;
+
+// Routine to return the unit-size mesh of a shape, building it on first use.
+static const Mesh &lookup(Shape shape, int slices, int stacks)
+{
+    ShapeKey key = { shape, slices, stacks };
+    std::map<ShapeKey, Mesh>::iterator entry = meshes.find(key);
+    Mesh mesh;
+
+    if (entry != meshes.end()) return entry->second;
+
+    switch (shape)
+    {
+    case WIRE_SPHERE:
+        mesh = meshWireSphere(1.0, slices, stacks);
+        break;
+    case SOLID_SPHERE:
+        mesh = meshSphere(1.0, slices, stacks);
+        break;
+    case WIRE_CONE:
+        mesh = meshWireCone(1.0, 1.0, slices, stacks);
+        break;
+    case SOLID_CONE:
+        mesh = meshCone(1.0, 1.0, slices, stacks);
+        break;
+    case CONE_BASE:
+        mesh = meshDisc(1.0, slices);
+        break;
+    }
+    return meshes.insert(std::make_pair(key, mesh)).first->second;
+}
+
+// Routine to draw a unit-size shape scaled by (x, y, z). Scaling unit
+// normals leaves them too long or short, hence GL_NORMALIZE.
+static void drawScaled(Shape shape, int slices, int stacks, double x, double y,
+                       double z)
+{
+    if (slices < 1 || stacks < 1) return;
+    glPushAttrib(GL_ENABLE_BIT);
+    glEnable(GL_NORMALIZE);
+    glPushMatrix();
+    glScaled(x, y, z);
+    meshDraw(lookup(shape, slices, stacks));
+    if (shape == SOLID_CONE)
+    {
+        // Base facing down the z-axis.
+        glRotatef(180.0, 1.0, 0.0, 0.0);
+        meshDraw(lookup(CONE_BASE, slices, 1));
+    }
+    glPopMatrix();
+    glPopAttrib();
+}
+
+void shapeCacheWireSphere(double radius, int slices, int stacks)
+{
+    drawScaled(WIRE_SPHERE, slices, stacks, radius, radius, radius);
+}
+
+void shapeCacheSolidSphere(double radius, int slices, int stacks)
+{
+    drawScaled(SOLID_SPHERE, slices, stacks, radius, radius, radius);
+}
+
+void shapeCacheWireCone(double base, double height, int slices, int stacks)
+{
+    drawScaled(WIRE_CONE, slices, stacks, base, base, height);
+}
+
+void shapeCacheSolidCone(double base, double height, int slices, int stacks)
+{
+    drawScaled(SOLID_CONE, slices, stacks, base, base, height);
+}
+
+const Mesh &shapeCacheWireSphereMesh(int slices, int stacks)
+{
+    return lookup(WIRE_SPHERE, slices, stacks);
+}
@@ -0,0 +1,30 @@
+/////////////////////////////////////////////////////////////////////////////
+// shapeCache.h
+//
+// Drop-in replacements for the freeglut sphere and cone routines that draw
+// from a cache of meshes (see mesh.h) instead of regenerating the vertices
+// on every call. Meshes are built at unit size and keyed by shape, slices
+// and stacks, so every sphere with the same tessellation, whatever its
+// radius, is generated and uploaded once per process and then drawn scaled.
+// Normals are renormalized after scaling, so lighting is unaffected.
+//
+// Unlike the freeglut routines these need no glutInit() and so also work
+// headless (see harness.h).
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef SHAPE_CACHE_H
+#define SHAPE_CACHE_H
+
+#include "mesh.h"
+
+// Routines with the arguments and output of their glut counterparts.
+void shapeCacheWireSphere(double radius, int slices, int stacks);
+void shapeCacheSolidSphere(double radius, int slices, int stacks);
+void shapeCacheWireCone(double base, double height, int slices, int stacks);
+void shapeCacheSolidCone(double base, double height, int slices, int stacks);
+
+// Routine to return the cached unit-radius mesh drawn by
+// shapeCacheWireSphere(), for callers that draw it themselves, instanced.
+const Mesh &shapeCacheWireSphereMesh(int slices, int stacks);
+
+#endif
@@ -0,0 +1,288 @@
+/////////////////////////////////////////////////////////////////////////////
+// skeleton.cpp
+//
+// Implementation of the skeletons declared in skeleton.h.
+/////////////////////////////////////////////////////////////////////////////
+
+#define _USE_MATH_DEFINES
+
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <GL/glew.h>
+
+#include "mesh.h"
+#include "skeleton.h"
+
+// Sphere tessellation, that of glutWireSphere(1.0, 10, 8) in the AnimateMan
+// programs.
+#define SPHERE_SLICES 10
+#define SPHERE_STACKS 8
+
+// A bone of a rig description.
+struct BoneDescription
+{
+    int parent;
+    float offset[3], axis[3];
+    int channel;
+    float baseAngle, post[3];
+    SkeletonShape shape;
+    float scale[3];
+    int part;
+};
+
+// The man of animateMan1.cpp: torso, head, upper and lower arms, upper and
+// lower legs and feet. Channels and parts are indices into partAngles.
+static const BoneDescription manBones[] =
+{
+    // Torso.
+    { -1, { 0.0, 0.0, 0.0 }, { 1.0, 0.0, 0.0 }, 0, 0.0, { 0.0, 0.0, 0.0 },
+      SKELETON_CUBE, { 4.0, 16.0, 4.0 }, 0 },
+    // Head.
+    { 0, { 0.0, 11.5, 0.0 }, { 1.0, 0.0, 0.0 }, -1, 0.0, { 0.0, 0.0, 0.0 },
+      SKELETON_SPHERE, { 2.0, 3.0, 2.0 }, -1 },
+    // Left upper and lower arm.
+    { 0, { 3.0, 8.0, 0.0 }, { 1.0, 0.0, 0.0 }, 1, 180.0, { 0.0, 4.0, 0.0 },
+      SKELETON_CUBE, { 2.0, 8.0, 2.0 }, 1 },
+    { 2, { 0.0, 4.0, 0.0 }, { 1.0, 0.0, 0.0 }, 2, 0.0, { 0.0, 4.0, 0.0 },
+      SKELETON_CUBE, { 2.0, 8.0, 2.0 }, 2 },
+    // Right upper and lower arm.
+    { 0, { -3.0, 8.0, 0.0 }, { 1.0, 0.0, 0.0 }, 3, 180.0, { 0.0, 4.0, 0.0 },
+      SKELETON_CUBE, { 2.0, 8.0, 2.0 }, 3 },
+    { 4, { 0.0, 4.0, 0.0 }, { 1.0, 0.0, 0.0 }, 4, 0.0, { 0.0, 4.0, 0.0 },
+      SKELETON_CUBE, { 2.0, 8.0, 2.0 }, 4 },
+    // Left upper and lower leg and foot.
+    { 0, { 1.5, -8.0, 0.0 }, { 1.0, 0.0, 0.0 }, 5, 0.0, { 0.0, -4.0, 0.0 },
+      SKELETON_CUBE, { 2.0, 8.0, 2.0 }, 5 },
+    { 6, { 0.0, -4.0, 0.0 }, { 1.0, 0.0, 0.0 }, 6, 0.0, { 0.0, -4.0, 0.0 },
+      SKELETON_CUBE, { 2.0, 8.0, 2.0 }, 6 },
+    { 7, { 0.0, -5.0, 0.5 }, { 1.0, 0.0, 0.0 }, -1, 0.0, { 0.0, 0.0, 0.0 },
+      SKELETON_CUBE, { 2.0, 1.0, 3.0 }, 6 },
+    // Right upper and lower leg and foot.
+    { 0, { -1.5, -8.0, 0.0 }, { 1.0, 0.0, 0.0 }, 7, 0.0, { 0.0, -4.0, 0.0 },
+      SKELETON_CUBE, { 2.0, 8.0, 2.0 }, 7 },
+    { 9, { 0.0, -4.0, 0.0 }, { 1.0, 0.0, 0.0 }, 8, 0.0, { 0.0, -4.0, 0.0 },
+      SKELETON_CUBE, { 2.0, 8.0, 2.0 }, 8 },
+    { 10, { 0.0, -5.0, 0.5 }, { 1.0, 0.0, 0.0 }, -1, 0.0, { 0.0, 0.0, 0.0 },
+      SKELETON_CUBE, { 2.0, 1.0, 3.0 }, 8 },
+};
+
+// Globals.
+static std::vector<float> transformed; // Shape vertices for skeletonDraw().
+static std::vector<float> vertexColors;
+static std::vector<unsigned int> batchLines; // Lines of skeletonDrawBatch().
+
+// Routine to append the lines of a unit cube or sphere scaled by scale, on
+// bone, to the skeleton's lines.
+static void addShape(Skeleton &skeleton, SkeletonShape shape,
+                     const float scale[3], int bone)
+{
+    static const unsigned int cubeEdges[24] =
+        { 0, 1, 2, 3, 4, 5, 6, 7, 0, 2, 1, 3, 4, 6, 5, 7, 0, 4, 1, 5, 2, 6, 3, 7 };
+    unsigned int first = skeleton.positions.size() / 3;
+    size_t k;
+    int i;
+
+    if (shape == SKELETON_CUBE)
+    {
+        // Corner i has x, y and z from bits 0, 1 and 2 of i.
+        for (i = 0; i < 8; i++)
+        {
+            skeleton.positions.push_back((i & 1 ? 0.5 : -0.5) * scale[0]);
+            skeleton.positions.push_back((i & 2 ? 0.5 : -0.5) * scale[1]);
+            skeleton.positions.push_back((i & 4 ? 0.5 : -0.5) * scale[2]);
+        }
+        for (i = 0; i < 24; i++) skeleton.lines.push_back(first + cubeEdges[i]);
+    }
+    else if (shape == SKELETON_SPHERE)
+    {
+        meshWireSphereLines(1.0, SPHERE_SLICES, SPHERE_STACKS,
+                            skeleton.positions, skeleton.lines);
+        for (k = 3 * first; k < skeleton.positions.size(); k++)
+            skeleton.positions[k] *= scale[k % 3];
+    }
+    skeleton.vertexBone.resize(skeleton.positions.size() / 3, bone);
+}
+
+void skeletonAddBone(Skeleton &skeleton, int parent, const float offset[3],
+                     const float axis[3], int channel, float baseAngle,
+                     const float post[3], SkeletonShape shape,
+                     const float scale[3], int part)
+{
+    float length = sqrt(axis[0] * axis[0] + axis[1] * axis[1] +
+                        axis[2] * axis[2]);
+    int k;
+
+    skeleton.parent.push_back(parent);
+    skeleton.channel.push_back(channel);
+    skeleton.baseAngle.push_back(baseAngle);
+    skeleton.shape.push_back(shape);
+    skeleton.part.push_back(part);
+    for (k = 0; k < 3; k++)
+    {
+        skeleton.offset.push_back(offset[k]);
+        skeleton.axis.push_back(axis[k] / length);
+        skeleton.post.push_back(post[k]);
+        skeleton.scale.push_back(scale[k]);
+    }
+    addShape(skeleton, shape, scale, skeleton.parent.size() - 1);
+}
+
+Skeleton skeletonMan(void)
+{
+    Skeleton skeleton;
+    const BoneDescription *bone;
+
+    for (bone = manBones; bone < manBones + sizeof(manBones) / sizeof(manBones[0]);
+         bone++)
+        skeletonAddBone(skeleton, bone->parent, bone->offset, bone->axis,
+                        bone->channel, bone->baseAngle, bone->post, bone->shape,
+                        bone->scale, bone->part);
+    return skeleton;
+}
+
+// Routine to set m (column-major) to the product a * b.
+static inline void multiply(const float *a, const float *b, float *m)
+{
+    int j;
+#ifdef __SSE2__
+    __m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+
+    // Column j of m is a times column j of b.
+    for (j = 0; j < 4; j++)
+        _mm_storeu_ps(m + 4 * j,
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[4 * j])),
+                                  _mm_mul_ps(a1, _mm_set1_ps(b[4 * j + 1]))),
+                       _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b[4 * j + 2])),
+                                  _mm_mul_ps(a3, _mm_set1_ps(b[4 * j + 3])))));
+#else
+    int i;
+    for (j = 0; j < 4; j++)
+        for (i = 0; i < 4; i++)
+            m[4 * j + i] = a[i] * b[4 * j] + a[4 + i] * b[4 * j + 1] +
+                           a[8 + i] * b[4 * j + 2] + a[12 + i] * b[4 * j + 3];
+#endif
+}
+
+void skeletonPose(const Skeleton &skeleton, const float root[16],
+                  const float *channels, float *world)
+{
+    int bones = skeletonBones(skeleton), b, k;
+    float local[16];
+
+    for (b = 0; b < bones; b++)
+    {
+        const float *o = &skeleton.offset[3 * b], *a = &skeleton.axis[3 * b];
+        const float *p = &skeleton.post[3 * b];
+        float angle = skeleton.baseAngle[b], c, s, t;
+
+        // local = translate(offset) * rotate(angle, axis) * translate(post),
+        // the rotation as glRotatef() makes it.
+        if (skeleton.channel[b] >= 0) angle += channels[skeleton.channel[b]];
+        c = cos(angle * M_PI / 180.0);
+        s = sin(angle * M_PI / 180.0);
+        t = 1.0 - c;
+        local[0] = a[0] * a[0] * t + c;
+        local[1] = a[1] * a[0] * t + a[2] * s;
+        local[2] = a[2] * a[0] * t - a[1] * s;
+        local[4] = a[0] * a[1] * t - a[2] * s;
+        local[5] = a[1] * a[1] * t + c;
+        local[6] = a[2] * a[1] * t + a[0] * s;
+        local[8] = a[0] * a[2] * t + a[1] * s;
+        local[9] = a[1] * a[2] * t - a[0] * s;
+        local[10] = a[2] * a[2] * t + c;
+        for (k = 0; k < 3; k++)
+            local[12 + k] = o[k] + local[k] * p[0] + local[4 + k] * p[1] +
+                            local[8 + k] * p[2];
+        local[3] = local[7] = local[11] = 0.0;
+        local[15] = 1.0;
+
+        multiply(skeleton.parent[b] < 0 ? root : world + 16 * skeleton.parent[b],
+                 local, world + 16 * b);
+    }
+}
+
+void skeletonTransform(const Skeleton &skeleton, const float *world,
+                       float *vertices)
+{
+    size_t count = skeleton.vertexBone.size(), v;
+
+    // Each vertex through its bone's matrix.
+    for (v = 0; v < count; v++)
+    {
+        const float *m = world + 16 * skeleton.vertexBone[v];
+        const float *p = &skeleton.positions[3 * v];
+#ifdef __SSE2__
+        float result[4];
+        _mm_storeu_ps(result,
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m), _mm_set1_ps(p[0])),
+                                  _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(p[1]))),
+                       _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(p[2])),
+                                  _mm_loadu_ps(m + 12))));
+        vertices[3 * v] = result[0];
+        vertices[3 * v + 1] = result[1];
+        vertices[3 * v + 2] = result[2];
+#else
+        int i;
+        for (i = 0; i < 3; i++)
+            vertices[3 * v + i] = m[i] * p[0] + m[4 + i] * p[1] +
+                                  m[8 + i] * p[2] + m[12 + i];
+#endif
+    }
+}
+
+void skeletonDraw(const Skeleton &skeleton, const float *world,
+                  const float *colors)
+{
+    size_t vertices = skeleton.vertexBone.size(), v;
+
+    if (vertices == 0) return;
+
+    transformed.resize(3 * vertices);
+    skeletonTransform(skeleton, world, &transformed[0]);
+    vertexColors.resize(3 * vertices);
+    for (v = 0; v < vertices; v++)
+    {
+        const float *color = colors + 3 * skeleton.vertexBone[v];
+        vertexColors[3 * v] = color[0];
+        vertexColors[3 * v + 1] = color[1];
+        vertexColors[3 * v + 2] = color[2];
+    }
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glVertexPointer(3, GL_FLOAT, 0, &transformed[0]);
+    glColorPointer(3, GL_FLOAT, 0, &vertexColors[0]);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glDrawElements(GL_LINES, skeleton.lines.size(), GL_UNSIGNED_INT,
+                   &skeleton.lines[0]);
+    glPopClientAttrib(); // Also restores the buffer bindings.
+}
+
+void skeletonDrawBatch(const Skeleton &skeleton, int count,
+                       const float color[3])
+{
+    size_t lines = skeleton.lines.size(), first, k;
+    unsigned int vertices = skeleton.vertexBone.size();
+
+    if (count <= 0 || lines == 0) return;
+
+    // The lines of every character, each indexing its own vertices; only
+    // grown when more characters are drawn than before.
+    for (first = batchLines.size(); first < lines * count; first += lines)
+        for (k = 0; k < lines; k++)
+            batchLines.push_back(skeleton.lines[k] + vertices * (first / lines));
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glVertexPointer(3, GL_FLOAT, 0, 0);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glColor3fv(color);
+    glDrawElements(GL_LINES, lines * count, GL_UNSIGNED_INT, &batchLines[0]);
+    glPopClientAttrib(); // Also restores the element buffer binding.
+}
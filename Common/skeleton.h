@@ -0,0 +1,95 @@
+/////////////////////////////////////////////////////////////////////////////
+// skeleton.h
+//
+// Data-driven character rigs. A skeleton is a list of bones held as flat
+// arrays, parents before children. Bone b sits in its parent's frame at
+// offset, turns about axis through baseAngle plus the pose value of its
+// channel, and its frame is then moved by post along the turned axes, as in
+//
+//     glTranslatef(offset); glRotatef(baseAngle + pose[channel], axis);
+//     glTranslatef(post);
+//
+// A bone may carry a shape, a wire cube or sphere of unit size scaled by
+// scale, centered on its frame.
+//
+// skeletonPose() evaluates the world matrix of every bone in one forward
+// sweep over the arrays, each a 4x4 product done four floats at a time with
+// SSE, instead of walking the OpenGL matrix stack. skeletonDraw() then
+// transforms the lines of all the shapes by their bones' matrices and draws
+// the whole character with one glDrawElements().
+//
+// Many posed characters in one color, such as the ghosted configurations of
+// animateMan1.cpp, can instead be transformed once with skeletonTransform()
+// into a vertex buffer, kept while their poses are unchanged, and drawn with
+// skeletonDrawBatch(), one glDrawElements() for all of them.
+//
+// skeletonMan() is the man of the AnimateMan programs, whose pose is the
+// partAngles of animateMan1.cpp.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef SKELETON_H
+#define SKELETON_H
+
+#include <vector>
+
+enum SkeletonShape { SKELETON_NONE, SKELETON_CUBE, SKELETON_SPHERE };
+
+// A skeleton: bone b's entries are element b of each array, or elements
+// 3 * b to 3 * b + 2 of the arrays of vectors.
+struct Skeleton
+{
+    std::vector<int> parent; // -1 for the root.
+    std::vector<float> offset, axis, post; // Vectors, see above.
+    std::vector<int> channel; // Pose value turning the bone, -1 for none.
+    std::vector<float> baseAngle; // Degrees.
+    std::vector<int> shape; // SkeletonShape.
+    std::vector<float> scale; // Shape scale along x, y, z.
+    std::vector<int> part; // Part the bone is selected with, -1 for none.
+
+    // Lines of all the shapes: vertex positions (x, y, z) in their bone's
+    // frame, the bone of each vertex, and the index pairs of the lines.
+    std::vector<float> positions;
+    std::vector<int> vertexBone;
+    std::vector<unsigned int> lines;
+};
+
+// Routine to append a bone to skeleton, its parent already there.
+void skeletonAddBone(Skeleton &skeleton, int parent, const float offset[3],
+                     const float axis[3], int channel, float baseAngle,
+                     const float post[3], SkeletonShape shape,
+                     const float scale[3], int part);
+
+// Routine to return the rig of the man of the AnimateMan programs.
+Skeleton skeletonMan(void);
+
+// Routine to return the number of bones of a skeleton.
+inline int skeletonBones(const Skeleton &skeleton)
+{
+    return skeleton.parent.size();
+}
+
+// Routine to write to world the 16 floats (column-major) of each bone's
+// matrix for the pose values channels, the root bone's parent frame being
+// root.
+void skeletonPose(const Skeleton &skeleton, const float root[16],
+                  const float *channels, float *world);
+
+// Routine to draw the shapes of a skeleton posed by skeletonPose(), those of
+// bone b in the color colors[3 * b] to colors[3 * b + 2]. The current
+// modelview and projection apply as usual.
+void skeletonDraw(const Skeleton &skeleton, const float *world,
+                  const float *colors);
+
+// Routine to write to vertices the positions (x, y, z) of the shape vertices
+// of a skeleton posed by skeletonPose(), 3 * skeleton.vertexBone.size()
+// floats.
+void skeletonTransform(const Skeleton &skeleton, const float *world,
+                       float *vertices);
+
+// Routine to draw in color count characters of a skeleton whose vertices,
+// written one character after another by skeletonTransform(), are in the
+// bound GL_ARRAY_BUFFER from offset 0.
+void skeletonDrawBatch(const Skeleton &skeleton, int count,
+                       const float color[3]);
+
+#endif
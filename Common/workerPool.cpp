@@ -0,0 +1,98 @@
+/////////////////////////////////////////////////////////////////////////////
+// workerPool.cpp
+//
+// Implementation of the worker pool declared in workerPool.h.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "workerPool.h"
+
+// Pool state. It is never freed: the workers wait on it until the process
+// exits.
+struct Pool
+{
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    unsigned long generation = 0; // Incremented for every loop.
+    int busy = 0; // Workers still on the current loop.
+    int workers = 0;
+
+    // The current loop.
+    const std::function<void(size_t, size_t)> *work = NULL;
+    size_t count = 0, chunkSize = 1;
+    std::atomic<size_t> next{0}; // First index of the next chunk.
+};
+
+// Globals.
+static Pool *pool = NULL;
+
+// Routine to work on chunks of the current loop until none are left.
+static void runChunks(void)
+{
+    size_t first;
+
+    while ((first = pool->next.fetch_add(pool->chunkSize)) < pool->count)
+        (*pool->work)(first, std::min(first + pool->chunkSize, pool->count));
+}
+
+// Routine run by each worker: wait for a loop, work on it, repeat.
+static void workerLoop(void)
+{
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    unsigned long seen = 0; // Workers start before the first loop.
+
+    for (;;)
+    {
+        pool->wake.wait(lock, [&seen] { return pool->generation != seen; });
+        seen = pool->generation;
+        lock.unlock();
+        runChunks();
+        lock.lock();
+        if (--pool->busy == 0) pool->done.notify_one();
+    }
+}
+
+// Routine to start the pool on first use.
+static void startPool(void)
+{
+    int k;
+
+    if (pool) return;
+    pool = new Pool;
+    pool->workers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    for (k = 0; k < pool->workers; k++) std::thread(workerLoop).detach();
+}
+
+void workerPoolFor(size_t count, size_t chunkSize,
+                   const std::function<void(size_t, size_t)> &work)
+{
+    startPool();
+    if (count == 0) return;
+
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->work = &work;
+        pool->count = count;
+        pool->chunkSize = std::max(chunkSize, (size_t)1);
+        pool->next = 0;
+        pool->busy = pool->workers;
+        pool->generation++;
+    }
+    pool->wake.notify_all();
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->done.wait(lock, [] { return pool->busy == 0; });
+}
+
+int workerPoolThreads(void)
+{
+    startPool();
+    return pool->workers + 1;
+}
@@ -0,0 +1,30 @@
+/////////////////////////////////////////////////////////////////////////////
+// workerPool.h
+//
+// A pool of worker threads for data-parallel loops. The threads, one fewer
+// than the hardware threads, are started on first use and then wait for
+// work; the calling thread works too. workerPoolFor() splits an index range
+// into chunks handed out in order from an atomic counter, so each thread
+// works through contiguous runs of the data and faster threads simply take
+// more chunks.
+//
+// Programs linking workerPool.o need -pthread.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <cstddef>
+#include <functional>
+
+// Routine to call work(first, last) for every chunk [first, last) of at
+// most chunkSize indices of [0, count), spread over the pool and the
+// calling thread; returns when all are done. Not reentrant.
+void workerPoolFor(size_t count, size_t chunkSize,
+                   const std::function<void(size_t, size_t)> &work);
+
+// Routine to return the number of threads workerPoolFor() uses, the
+// calling thread included.
+int workerPoolThreads(void);
+
+#endif
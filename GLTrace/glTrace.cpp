@@ -0,0 +1,481 @@
+/////////////////////////////////////////////////////////////////////////////
+// glTrace.cpp
+//
+// GL call tracer loaded with LD_PRELOAD, so no program needs changing:
+//
+//     LD_PRELOAD=../../GLTrace/libglTrace.so ./prog42
+//
+// The tracer defines the GL entry points the programs (and freeglut's shape
+// routines) use, counts each call and forwards it to the real libGL.
+// Entry points loaded through glXGetProcAddress() or eglGetProcAddress(),
+// as GLEW does for everything past OpenGL 1.1, are traced as well.
+//
+// A frame ends at a buffer swap, or at glFlush()/glFinish() for
+// single-buffered and headless programs. For every frame one line is
+// written with the number of calls, draw calls (glBegin/glEnd pairs, array
+// draws, display lists and rectangles), vertices submitted, state changes
+// (enables, binds, material, light and raster state, and colors set outside
+// glBegin/glEnd) and the busiest entry points. At exit the totals per entry
+// point are written.
+//
+// Output goes to stderr, or to the file named by GLTRACE_OUTPUT. Set
+// GLTRACE_TOP to change the number of entry points listed per frame
+// (default 5).
+/////////////////////////////////////////////////////////////////////////////
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include <dlfcn.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <GL/glx.h>
+#include <EGL/egl.h>
+
+// Call categories.
+enum { CALL, VERTEX, STATE, COLOR, MATRIX, DRAW };
+
+// Traced entry points with their categories. Draw calls, whose vertex
+// counts depend on their arguments, and frame boundaries are written out
+// by hand further down.
+#define TRACED_CALLS \
+    X(VERTEX, glVertex2f, (GLfloat x, GLfloat y), (x, y)) \
+    X(VERTEX, glVertex2i, (GLint x, GLint y), (x, y)) \
+    X(VERTEX, glVertex3f, (GLfloat x, GLfloat y, GLfloat z), (x, y, z)) \
+    X(VERTEX, glVertex3fv, (const GLfloat *v), (v)) \
+    X(VERTEX, glVertex3d, (GLdouble x, GLdouble y, GLdouble z), (x, y, z)) \
+    X(VERTEX, glVertex3dv, (const GLdouble *v), (v)) \
+    X(VERTEX, glArrayElement, (GLint i), (i)) \
+    X(CALL, glNormal3f, (GLfloat x, GLfloat y, GLfloat z), (x, y, z)) \
+    X(CALL, glNormal3fv, (const GLfloat *v), (v)) \
+    X(CALL, glNormal3d, (GLdouble x, GLdouble y, GLdouble z), (x, y, z)) \
+    X(CALL, glNormal3dv, (const GLdouble *v), (v)) \
+    X(CALL, glTexCoord2f, (GLfloat s, GLfloat t), (s, t)) \
+    X(CALL, glTexCoord2d, (GLdouble s, GLdouble t), (s, t)) \
+    X(COLOR, glColor3f, (GLfloat r, GLfloat g, GLfloat b), (r, g, b)) \
+    X(COLOR, glColor3fv, (const GLfloat *v), (v)) \
+    X(COLOR, glColor3ub, (GLubyte r, GLubyte g, GLubyte b), (r, g, b)) \
+    X(COLOR, glColor3ubv, (const GLubyte *v), (v)) \
+    X(COLOR, glColor4f, (GLfloat r, GLfloat g, GLfloat b, GLfloat a), \
+      (r, g, b, a)) \
+    X(COLOR, glColor4fv, (const GLfloat *v), (v)) \
+    X(MATRIX, glPushMatrix, (void), ()) \
+    X(MATRIX, glPopMatrix, (void), ()) \
+    X(MATRIX, glLoadIdentity, (void), ()) \
+    X(MATRIX, glMatrixMode, (GLenum mode), (mode)) \
+    X(MATRIX, glTranslatef, (GLfloat x, GLfloat y, GLfloat z), (x, y, z)) \
+    X(MATRIX, glTranslated, (GLdouble x, GLdouble y, GLdouble z), (x, y, z)) \
+    X(MATRIX, glRotatef, (GLfloat a, GLfloat x, GLfloat y, GLfloat z), \
+      (a, x, y, z)) \
+    X(MATRIX, glRotated, (GLdouble a, GLdouble x, GLdouble y, GLdouble z), \
+      (a, x, y, z)) \
+    X(MATRIX, glScalef, (GLfloat x, GLfloat y, GLfloat z), (x, y, z)) \
+    X(MATRIX, glScaled, (GLdouble x, GLdouble y, GLdouble z), (x, y, z)) \
+    X(MATRIX, glMultMatrixf, (const GLfloat *m), (m)) \
+    X(MATRIX, glMultMatrixd, (const GLdouble *m), (m)) \
+    X(MATRIX, glLoadMatrixf, (const GLfloat *m), (m)) \
+    X(MATRIX, glFrustum, (GLdouble l, GLdouble r, GLdouble b, GLdouble t, \
+                          GLdouble n, GLdouble f), (l, r, b, t, n, f)) \
+    X(MATRIX, glOrtho, (GLdouble l, GLdouble r, GLdouble b, GLdouble t, \
+                        GLdouble n, GLdouble f), (l, r, b, t, n, f)) \
+    X(STATE, glEnable, (GLenum cap), (cap)) \
+    X(STATE, glDisable, (GLenum cap), (cap)) \
+    X(STATE, glEnableClientState, (GLenum array), (array)) \
+    X(STATE, glDisableClientState, (GLenum array), (array)) \
+    X(STATE, glPolygonMode, (GLenum face, GLenum mode), (face, mode)) \
+    X(STATE, glLineWidth, (GLfloat width), (width)) \
+    X(STATE, glPointSize, (GLfloat size), (size)) \
+    X(STATE, glLineStipple, (GLint factor, GLushort pattern), \
+      (factor, pattern)) \
+    X(STATE, glShadeModel, (GLenum mode), (mode)) \
+    X(STATE, glCullFace, (GLenum mode), (mode)) \
+    X(STATE, glFrontFace, (GLenum mode), (mode)) \
+    X(STATE, glDepthFunc, (GLenum func), (func)) \
+    X(STATE, glViewport, (GLint x, GLint y, GLsizei w, GLsizei h), \
+      (x, y, w, h)) \
+    X(STATE, glColorMaterial, (GLenum face, GLenum mode), (face, mode)) \
+    X(STATE, glMaterialfv, (GLenum face, GLenum pname, const GLfloat *v), \
+      (face, pname, v)) \
+    X(STATE, glLightf, (GLenum light, GLenum pname, GLfloat v), \
+      (light, pname, v)) \
+    X(STATE, glLightfv, (GLenum light, GLenum pname, const GLfloat *v), \
+      (light, pname, v)) \
+    X(STATE, glLightModeli, (GLenum pname, GLint v), (pname, v)) \
+    X(STATE, glLightModelfv, (GLenum pname, const GLfloat *v), (pname, v)) \
+    X(STATE, glTexParameteri, (GLenum target, GLenum pname, GLint v), \
+      (target, pname, v)) \
+    X(STATE, glTexEnvf, (GLenum target, GLenum pname, GLfloat v), \
+      (target, pname, v)) \
+    X(STATE, glTexGeni, (GLenum coord, GLenum pname, GLint v), \
+      (coord, pname, v)) \
+    X(STATE, glBindTexture, (GLenum target, GLuint texture), \
+      (target, texture)) \
+    X(STATE, glBindBuffer, (GLenum target, GLuint buffer), (target, buffer)) \
+    X(STATE, glBindVertexArray, (GLuint array), (array)) \
+    X(STATE, glPushAttrib, (GLbitfield mask), (mask)) \
+    X(STATE, glPopAttrib, (void), ()) \
+    X(STATE, glVertexPointer, (GLint size, GLenum type, GLsizei stride, \
+                               const void *p), (size, type, stride, p)) \
+    X(STATE, glNormalPointer, (GLenum type, GLsizei stride, const void *p), \
+      (type, stride, p)) \
+    X(STATE, glColorPointer, (GLint size, GLenum type, GLsizei stride, \
+                              const void *p), (size, type, stride, p)) \
+    X(STATE, glTexCoordPointer, (GLint size, GLenum type, GLsizei stride, \
+                                 const void *p), (size, type, stride, p)) \
+    X(CALL, glClear, (GLbitfield mask), (mask)) \
+    X(CALL, glClearColor, (GLfloat r, GLfloat g, GLfloat b, GLfloat a), \
+      (r, g, b, a)) \
+    X(CALL, glRasterPos3f, (GLfloat x, GLfloat y, GLfloat z), (x, y, z)) \
+    X(CALL, glBufferData, (GLenum target, GLsizeiptr size, const void *data, \
+                           GLenum usage), (target, size, data, usage)) \
+    X(CALL, glBufferSubData, (GLenum target, GLintptr offset, \
+                              GLsizeiptr size, const void *data), \
+      (target, offset, size, data)) \
+    X(CALL, glTexImage2D, (GLenum target, GLint level, GLint internal, \
+                           GLsizei w, GLsizei h, GLint border, GLenum format, \
+                           GLenum type, const void *pixels), \
+      (target, level, internal, w, h, border, format, type, pixels)) \
+    X(CALL, glTexSubImage2D, (GLenum target, GLint level, GLint x, GLint y, \
+                              GLsizei w, GLsizei h, GLenum format, \
+                              GLenum type, const void *pixels), \
+      (target, level, x, y, w, h, format, type, pixels)) \
+    X(CALL, glNewList, (GLuint list, GLenum mode), (list, mode)) \
+    X(CALL, glEndList, (void), ())
+
+// Entry point indices.
+enum
+{
+#define X(category, name, params, args) ENTRY_##name,
+    TRACED_CALLS
+#undef X
+    ENTRY_glBegin, ENTRY_glEnd, ENTRY_glDrawArrays, ENTRY_glDrawElements,
+    ENTRY_glMultiDrawArrays, ENTRY_glMultiDrawElements,
+    ENTRY_glDrawArraysInstanced, ENTRY_glDrawElementsInstanced,
+    ENTRY_glCallList, ENTRY_glCallLists, ENTRY_glRectf,
+    ENTRY_COUNT
+};
+
+// Entry point names, in index order.
+static const char *entryNames[ENTRY_COUNT] =
+{
+#define X(category, name, params, args) #name,
+    TRACED_CALLS
+#undef X
+    "glBegin", "glEnd", "glDrawArrays", "glDrawElements",
+    "glMultiDrawArrays", "glMultiDrawElements", "glDrawArraysInstanced",
+    "glDrawElementsInstanced", "glCallList", "glCallLists", "glRectf"
+};
+
+// Per-frame and whole-run counters.
+struct TraceCounts
+{
+    unsigned long calls, draws, vertices, stateChanges;
+    unsigned long entries[ENTRY_COUNT];
+};
+
+// Globals.
+static TraceCounts frame, total; // Current frame and all frames.
+static unsigned long frameNumber = 0;
+static int insideBegin = 0; // Between glBegin() and glEnd()?
+static FILE *output = NULL;
+static int topEntries = 5; // Entry points listed per frame.
+
+// Routine to look up the real entry point in the next library along.
+static void *realFunction(const char *name)
+{
+    typedef void *(*GetProcAddress)(const GLubyte *);
+    static GetProcAddress getProcAddress = NULL;
+    void *func = dlsym(RTLD_NEXT, name);
+
+    if (func) return func;
+    if (!getProcAddress)
+        getProcAddress = (GetProcAddress)dlsym(RTLD_NEXT, "glXGetProcAddressARB");
+    if (getProcAddress) func = getProcAddress((const GLubyte *)name);
+    if (!func)
+    {
+        fprintf(stderr, "glTrace: can't find %s.\n", name);
+        abort();
+    }
+    return func;
+}
+
+// Routine to count one call.
+static void count(int entry, int category)
+{
+    frame.calls++;
+    frame.entries[entry]++;
+    if (category == VERTEX) frame.vertices++;
+    else if (category == STATE || (category == COLOR && !insideBegin))
+        frame.stateChanges++;
+}
+
+// Routine to count a draw call submitting vertices vertices.
+static void countDraw(int entry, unsigned long vertices)
+{
+    count(entry, DRAW);
+    frame.draws++;
+    frame.vertices += vertices;
+}
+
+// Routine to write the entry points of counts with the most calls, at most
+// limit of them.
+static void writeTopEntries(const TraceCounts &counts, int limit)
+{
+    std::vector<int> order;
+    int i;
+
+    for (i = 0; i < ENTRY_COUNT; i++)
+        if (counts.entries[i]) order.push_back(i);
+    std::sort(order.begin(), order.end(), [&counts](int a, int b)
+              { return counts.entries[a] > counts.entries[b]; });
+    if ((int)order.size() > limit) order.resize(limit);
+
+    for (i = 0; i < (int)order.size(); i++)
+        fprintf(output, "%s %s %lu", i ? "," : "", entryNames[order[i]],
+                counts.entries[order[i]]);
+}
+
+// Routine to write the totals at exit.
+static void writeTotals(void)
+{
+    unsigned long frames = frameNumber ? frameNumber : 1;
+
+    fprintf(output, "glTrace: %lu frames, per frame: %.1f calls, %.1f draws, "
+            "%.1f vertices, %.1f state changes\n", frameNumber,
+            (double)total.calls / frames, (double)total.draws / frames,
+            (double)total.vertices / frames, (double)total.stateChanges / frames);
+    fprintf(output, "glTrace: calls by entry point:");
+    writeTopEntries(total, ENTRY_COUNT);
+    fprintf(output, "\n");
+    fflush(output);
+}
+
+// Routine to open the output on first use.
+static void openOutput(void)
+{
+    const char *name = getenv("GLTRACE_OUTPUT");
+    const char *top = getenv("GLTRACE_TOP");
+
+    output = name ? fopen(name, "w") : NULL;
+    if (!output) output = stderr;
+    if (top) topEntries = atoi(top);
+    atexit(writeTotals);
+}
+
+// Routine to close the current frame, if anything was drawn in it.
+static void endFrame(void)
+{
+    int i;
+
+    if (frame.calls == 0) return;
+    if (!output) openOutput();
+
+    fprintf(output, "frame %lu: %lu calls, %lu draws, %lu vertices, "
+            "%lu state changes;", frameNumber++, frame.calls, frame.draws,
+            frame.vertices, frame.stateChanges);
+    writeTopEntries(frame, topEntries);
+    fprintf(output, "\n");
+
+    total.calls += frame.calls;
+    total.draws += frame.draws;
+    total.vertices += frame.vertices;
+    total.stateChanges += frame.stateChanges;
+    for (i = 0; i < ENTRY_COUNT; i++) total.entries[i] += frame.entries[i];
+    memset(&frame, 0, sizeof(frame));
+}
+
+// Generated wrappers.
+#define X(category, name, params, args) \
+    extern "C" void name params \
+    { \
+        static void (*real) params = \
+            (void (*) params)realFunction(#name); \
+        count(ENTRY_##name, category); \
+        real args; \
+    }
+TRACED_CALLS
+#undef X
+
+// Hand-written wrappers.
+extern "C" void glBegin(GLenum mode)
+{
+    static void (*real)(GLenum) = (void (*)(GLenum))realFunction("glBegin");
+    countDraw(ENTRY_glBegin, 0);
+    insideBegin = 1;
+    real(mode);
+}
+
+extern "C" void glEnd(void)
+{
+    static void (*real)(void) = (void (*)(void))realFunction("glEnd");
+    count(ENTRY_glEnd, CALL);
+    insideBegin = 0;
+    real();
+}
+
+extern "C" void glDrawArrays(GLenum mode, GLint first, GLsizei n)
+{
+    static void (*real)(GLenum, GLint, GLsizei) =
+        (void (*)(GLenum, GLint, GLsizei))realFunction("glDrawArrays");
+    countDraw(ENTRY_glDrawArrays, n);
+    real(mode, first, n);
+}
+
+extern "C" void glDrawElements(GLenum mode, GLsizei n, GLenum type,
+                               const void *indices)
+{
+    static void (*real)(GLenum, GLsizei, GLenum, const void *) =
+        (void (*)(GLenum, GLsizei, GLenum, const void *))
+        realFunction("glDrawElements");
+    countDraw(ENTRY_glDrawElements, n);
+    real(mode, n, type, indices);
+}
+
+extern "C" void glMultiDrawArrays(GLenum mode, const GLint *first,
+                                  const GLsizei *n, GLsizei drawCount)
+{
+    static PFNGLMULTIDRAWARRAYSPROC real =
+        (PFNGLMULTIDRAWARRAYSPROC)realFunction("glMultiDrawArrays");
+    unsigned long vertices = 0;
+    for (GLsizei i = 0; i < drawCount; i++) vertices += n[i];
+    countDraw(ENTRY_glMultiDrawArrays, vertices);
+    real(mode, first, n, drawCount);
+}
+
+extern "C" void glMultiDrawElements(GLenum mode, const GLsizei *n,
+                                    GLenum type, const void *const *indices,
+                                    GLsizei drawCount)
+{
+    static PFNGLMULTIDRAWELEMENTSPROC real =
+        (PFNGLMULTIDRAWELEMENTSPROC)realFunction("glMultiDrawElements");
+    unsigned long vertices = 0;
+    for (GLsizei i = 0; i < drawCount; i++) vertices += n[i];
+    countDraw(ENTRY_glMultiDrawElements, vertices);
+    real(mode, n, type, indices, drawCount);
+}
+
+extern "C" void glDrawArraysInstanced(GLenum mode, GLint first, GLsizei n,
+                                      GLsizei instances)
+{
+    static PFNGLDRAWARRAYSINSTANCEDPROC real =
+        (PFNGLDRAWARRAYSINSTANCEDPROC)realFunction("glDrawArraysInstanced");
+    countDraw(ENTRY_glDrawArraysInstanced, (unsigned long)n * instances);
+    real(mode, first, n, instances);
+}
+
+extern "C" void glDrawElementsInstanced(GLenum mode, GLsizei n, GLenum type,
+                                        const void *indices, GLsizei instances)
+{
+    static PFNGLDRAWELEMENTSINSTANCEDPROC real =
+        (PFNGLDRAWELEMENTSINSTANCEDPROC)realFunction("glDrawElementsInstanced");
+    countDraw(ENTRY_glDrawElementsInstanced, (unsigned long)n * instances);
+    real(mode, n, type, indices, instances);
+}
+
+// The contents of display lists are counted when the lists are compiled.
+extern "C" void glCallList(GLuint list)
+{
+    static void (*real)(GLuint) = (void (*)(GLuint))realFunction("glCallList");
+    countDraw(ENTRY_glCallList, 0);
+    real(list);
+}
+
+extern "C" void glCallLists(GLsizei n, GLenum type, const void *lists)
+{
+    static void (*real)(GLsizei, GLenum, const void *) =
+        (void (*)(GLsizei, GLenum, const void *))realFunction("glCallLists");
+    countDraw(ENTRY_glCallLists, 0);
+    real(n, type, lists);
+}
+
+extern "C" void glRectf(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2)
+{
+    static void (*real)(GLfloat, GLfloat, GLfloat, GLfloat) =
+        (void (*)(GLfloat, GLfloat, GLfloat, GLfloat))realFunction("glRectf");
+    countDraw(ENTRY_glRectf, 4);
+    real(x1, y1, x2, y2);
+}
+
+// Frame boundaries.
+extern "C" void glFlush(void)
+{
+    static void (*real)(void) = (void (*)(void))realFunction("glFlush");
+    real();
+    endFrame();
+}
+
+extern "C" void glFinish(void)
+{
+    static void (*real)(void) = (void (*)(void))realFunction("glFinish");
+    real();
+    endFrame();
+}
+
+extern "C" void glXSwapBuffers(Display *display, GLXDrawable drawable)
+{
+    static void (*real)(Display *, GLXDrawable) =
+        (void (*)(Display *, GLXDrawable))realFunction("glXSwapBuffers");
+    real(display, drawable);
+    endFrame();
+}
+
+extern "C" EGLBoolean eglSwapBuffers(EGLDisplay display, EGLSurface surface)
+{
+    static EGLBoolean (*real)(EGLDisplay, EGLSurface) =
+        (EGLBoolean (*)(EGLDisplay, EGLSurface))realFunction("eglSwapBuffers");
+    EGLBoolean result = real(display, surface);
+    endFrame();
+    return result;
+}
+
+// Routine to return the wrapper for a traced entry point, or NULL.
+static void *tracedFunction(const char *name)
+{
+    static const struct { const char *name; void *func; } wrappers[] =
+    {
+#define X(category, name, params, args) { #name, (void *)name },
+        TRACED_CALLS
+#undef X
+        { "glDrawArrays", (void *)glDrawArrays },
+        { "glDrawElements", (void *)glDrawElements },
+        { "glMultiDrawArrays", (void *)glMultiDrawArrays },
+        { "glMultiDrawElements", (void *)glMultiDrawElements },
+        { "glDrawArraysInstanced", (void *)glDrawArraysInstanced },
+        { "glDrawElementsInstanced", (void *)glDrawElementsInstanced },
+        { "glFlush", (void *)glFlush },
+        { "glFinish", (void *)glFinish }
+    };
+
+    for (size_t i = 0; i < sizeof(wrappers) / sizeof(wrappers[0]); i++)
+        if (!strcmp(name, wrappers[i].name)) return wrappers[i].func;
+    return NULL;
+}
+
+// Entry points loaded at run time (GLEW) are routed through the wrappers.
+extern "C" __GLXextFuncPtr glXGetProcAddressARB(const GLubyte *name)
+{
+    static __GLXextFuncPtr (*real)(const GLubyte *) =
+        (__GLXextFuncPtr (*)(const GLubyte *))realFunction("glXGetProcAddressARB");
+    void *func = tracedFunction((const char *)name);
+    return func ? (__GLXextFuncPtr)func : real(name);
+}
+
+extern "C" __GLXextFuncPtr glXGetProcAddress(const GLubyte *name)
+{
+    return glXGetProcAddressARB(name);
+}
+
+extern "C" __eglMustCastToProperFunctionPointerType
+eglGetProcAddress(const char *name)
+{
+    static __eglMustCastToProperFunctionPointerType (*real)(const char *) =
+        (__eglMustCastToProperFunctionPointerType (*)(const char *))
+        realFunction("eglGetProcAddress");
+    void *func = tracedFunction(name);
+    return func ? (__eglMustCastToProperFunctionPointerType)func : real(name);
+}
@@ -0,0 +1,83 @@
+/////////////////////////////////////////////////////////////////////////////
+// keyframeConvert.cpp
+//
+// Converts between the keyframe files of the AnimateMan programs: text (one
+// frame of 11 numbers per line), the binary format of Common/keyframes.h,
+// which they map at load instead of parsing, and the compressed clips of
+// Common/keyframeClip.h, for archives:
+//
+//     ./keyframeConvert IN OUT
+//
+// IN is read by its extension, .bin, .clip or else text. OUT is written as
+// a clip if it ends in .clip, else in the binary format; if it is already a
+// binary keyframe file only the frames that differ are rewritten.
+/////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>
+#include <iostream>
+
+#include "keyframes.h"
+#include "keyframeClip.h"
+
+// Routine to return if path ends with extension.
+static int hasExtension(const char *path, const char *extension)
+{
+    size_t length = strlen(path), extensionLength = strlen(extension);
+
+    return length >= extensionLength &&
+           !strcmp(path + length - extensionLength, extension);
+}
+
+// Routine to read the frames of the file at path, of any format, into set.
+static int readFrames(const char *path, KeyframeSet &set)
+{
+    KeyframeClip clip;
+
+    if (hasExtension(path, ".bin")) return keyframesOpen(path, set);
+    if (!hasExtension(path, ".clip")) return keyframesReadText(path, set);
+
+    if (!keyframeClipOpen(path, clip)) return 0;
+    keyframeClipRead(clip, set);
+    keyframeClipClose(clip);
+    return 1;
+}
+
+// Main routine.
+int main(int argc, char **argv)
+{
+    KeyframeSet set;
+    KeyframeWriter writer;
+    long written;
+    size_t bytes;
+
+    if (argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " IN.{txt,bin,clip} OUT.{bin,clip}"
+                  << std::endl;
+        return 2;
+    }
+
+    if (!readFrames(argv[1], set)) return 1;
+
+    if (hasExtension(argv[2], ".clip"))
+    {
+        bytes = keyframeClipWrite(argv[2], set.frames, set.count);
+        if (bytes == 0) return 1;
+        std::cout << argv[2] << ": " << set.count << " frames in " << bytes
+                  << " bytes." << std::endl;
+        return 0;
+    }
+
+    if (!keyframeWriterOpen(writer, argv[2])) return 1;
+    written = keyframeWriterSync(writer, set.frames, set.count);
+    keyframeWriterClose(writer);
+    if (written < 0)
+    {
+        std::cerr << argv[2] << ": write failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << argv[2] << ": " << set.count << " frames, " << written
+              << " written." << std::endl;
+    return 0;
+}
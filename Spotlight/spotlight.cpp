@@ -24,6 +24,9 @@
 #include <GL/glew.h>
 #include <GL/freeglut.h> 
 
+#include "harness.h"
+#include "shapeCache.h"
+
 // Globals.
 float lightPos[] = { 0.0, 3.0, 0.0, 1.0 }; // Spotlight position.
 static float spotAngle = 10.0; // Spotlight cone half-angle.
@@ -41,7 +44,7 @@ void writeBitmapString(void *font, std::string string)
 
     strcpy(s, string.data());
 
-	for (c = s; *c != '\0'; c++) glutBitmapCharacter(font, *c);
+	for (c = s; *c != '\0'; c++) harnessBitmapCharacter(font, *c);
 }
 
 // Routine to convert floating point to char string.
@@ -117,7 +120,7 @@ void drawScene()
 	glDisable(GL_LIGHTING);
 	glRotatef(-90.0, 1.0, 0.0, 0.0);
 	glColor3f(1.0, 1.0, 1.0);
-	glutWireCone(3.0 * tan(spotAngle / 180.0 * M_PI), 3.0, 20, 20);
+	shapeCacheWireCone(3.0 * tan(spotAngle / 180.0 * M_PI), 3.0, 20, 20);
 	glEnable(GL_LIGHTING);
 	glPopMatrix();
 
@@ -144,11 +147,11 @@ void drawScene()
 			else if ((i + j) % 3 == 1) glColor4f(0.0, 1.0, 0.0, 1.0);
 			else glColor4f(0.0, 0.0, 1.0, 1.0);
 
-			glutSolidSphere(0.5, 20.0, 16.0);
+			shapeCacheSolidSphere(0.5, 20.0, 16.0);
 			glPopMatrix();
 		}
 
-	glutSwapBuffers();
+	harnessSwapBuffers();
 }
 
 // OpenGL window reshape routine.
@@ -172,11 +175,11 @@ void keyInput(unsigned char key, int x, int y)
 		break;
 	case 't':
 		if (spotExponent > 0.0) spotExponent -= 0.1;
-		glutPostRedisplay();
+		harnessPostRedisplay();
 		break;
 	case 'T':
 		spotExponent += 0.1;
-		glutPostRedisplay();
+		harnessPostRedisplay();
 		break;
 	default:
 		break;
@@ -210,7 +213,7 @@ void specialKeyInput(int key, int x, int y)
 	{
 		if (xMove < 4.0) xMove += 0.1;
 	}
-	glutPostRedisplay();
+	harnessPostRedisplay();
 }
 
 // Routine to output interaction instructions to the C++ window.
@@ -226,24 +229,24 @@ void printInteraction(void)
 int main(int argc, char **argv)
 {
 	printInteraction();
-	glutInit(&argc, argv);
+	harnessInit(&argc, argv);
 
 	glutInitContextVersion(3, 1);
 	glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
 
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
-	glutInitWindowSize(500, 500);
+	harnessInitWindowSize(500, 500);
 	glutInitWindowPosition(100, 100);
-	glutCreateWindow("spotlight.cpp");
-	glutDisplayFunc(drawScene);
-	glutReshapeFunc(resize);
-	glutKeyboardFunc(keyInput);
-	glutSpecialFunc(specialKeyInput);
+	harnessCreateWindow("spotlight.cpp");
+	harnessDisplayFunc(drawScene);
+	harnessReshapeFunc(resize);
+	harnessKeyboardFunc(keyInput);
+	harnessSpecialFunc(specialKeyInput);
 
 	glewExperimental = GL_TRUE;
 	glewInit();
 
 	setup();
 
-	glutMainLoop();
+	harnessMainLoop();
 }
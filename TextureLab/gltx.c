@@ -2,6 +2,19 @@
  *  Simple SGI .rgb (IRIS RGB) image file reader ripped off from
  *  texture.c (written by David Blythe).  See the SIGGRAPH '96
  *  Advanced OpenGL course notes.
+ *
+ *  Rows are decoded in parallel: every row of every channel can be
+ *  found on its own through the RLE row tables, so the image is cut
+ *  into bands of BAND_ROWS rows, which one thread per processor takes
+ *  in turn.  A thread decodes the three channels of each row of its band
+ *  into rows of its own, still in cache, then interleaves them into the
+ *  image.  Programs linking gltx.c need -pthread.
+ *
+ *  The interleaving is done 16 or 32 pixels at a time with byte
+ *  shuffles, by AVX2 or SSSE3 code chosen at run time for the processor
+ *  at hand, else by a loop; setting GLTX_NO_SIMD in the environment
+ *  forces the loop.  RLE runs are expanded 16 bytes at a time with SSE2,
+ *  into rows with room for the last 16 to run over.
  */
 
 
@@ -10,185 +23,437 @@
 #include <stdlib.h> 
 #include <string.h>
 #include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GLTX_X86
+#include <immintrin.h>
+#endif
 #include "gltx.h"
 
 
+/* private defines */
+#define BAND_ROWS 16			/* rows a thread decodes at a time */
+#define PARALLEL_PIXELS 262144		/* fewest pixels decoded in parallel */
+#define MAX_THREADS 64
+#define ROW_SLACK 16			/* bytes a row may be overrun by */
+
+
 /* private typedefs */
+
+/* The file is mapped whole and read in place: the header and the RLE
+ * row tables at open, then each row straight from the mapping, with no
+ * seeks, reads or staging buffers.  The tables are checked against the
+ * length of the file at open, so decoding never reads past its end.
+ */
 typedef struct _rawImageRec {
     unsigned short imagic;
     unsigned short type;
     unsigned short dim;
     unsigned short sizeX, sizeY, sizeZ;
-    unsigned long min, max;
-    unsigned long wasteBytes;
-    char name[80];
-    unsigned long colorMap;
-    FILE *file;
-    unsigned char *tmp, *tmpR, *tmpG, *tmpB;
-    unsigned long rleEnd;
+    const unsigned char *map;		/* mapping of the whole file */
+    size_t mapLength;
     GLuint *rowStart;
     GLint *rowSize;
 } rawImageRec;
 
+/* Routine to interleave count bytes each of r, g and b into out. */
+typedef void (*interleaveFunc)(const unsigned char *r, const unsigned char *g,
+			       const unsigned char *b, unsigned char *out,
+			       int count);
+
+/* An image being decoded, shared by the threads decoding it. */
+typedef struct _rawDecodeJob {
+    rawImageRec *raw;
+    unsigned char *data;
+    interleaveFunc interleave;
+    atomic_int nextBand;
+} rawDecodeJob;
+
+/* A thread decoding bands of a job, and its rows of each channel. */
+typedef struct _rawDecodeThread {
+    rawDecodeJob *job;
+    unsigned char *tmpR, *tmpG, *tmpB;
+} rawDecodeThread;
+
 
 /* private functions */
-static void ConvertShort(unsigned short *array, long length)
+
+/* Big-endian values of the file. */
+static unsigned short GetShort(const unsigned char *ptr)
 {
-    unsigned long b1, b2;
-    unsigned char *ptr;
-
-    ptr = (unsigned char *)array;
-    while (length--) {
-	b1 = *ptr++;
-	b2 = *ptr++;
-	*array++ = (b1 << 8) | (b2);
-    }
+    return (ptr[0] << 8) | ptr[1];
+}
+
+static GLuint GetLong(const unsigned char *ptr)
+{
+    return ((GLuint)ptr[0] << 24) | ((GLuint)ptr[1] << 16) |
+	((GLuint)ptr[2] << 8) | (GLuint)ptr[3];
 }
 
-static void ConvertLong(GLuint *array, long length)
+static void RawImageClose(rawImageRec *raw)
 {
-    unsigned long b1, b2, b3, b4;
-    unsigned char *ptr;
-
-    ptr = (unsigned char *)array;
-    while (length--) {
-	b1 = *ptr++;
-	b2 = *ptr++;
-	b3 = *ptr++;
-	b4 = *ptr++;
-	*array++ = (b1 << 24) | (b2 << 16) | (b3 << 8) | (b4);
+    if (raw->map != NULL) {
+	munmap((void *)raw->map, raw->mapLength);
     }
+    free(raw->rowStart);
+    free(raw->rowSize);
+
+    free(raw);
 }
 
 static rawImageRec *RawImageOpen(char *fileName)
 {
-    union {
-	int testWord;
-	char testByte[4];
-    } endianTest;
     rawImageRec *raw;
-    GLenum swapFlag;
-    int x;
-
-    endianTest.testWord = 1;
-    if (endianTest.testByte[0] == 1) {
-	swapFlag = GL_TRUE;
-    } else {
-	swapFlag = GL_FALSE;
-    }
+    struct stat status;
+    void *map;
+    int fd, x, rows;
 
-    raw = (rawImageRec *)malloc(sizeof(rawImageRec));
+    raw = (rawImageRec *)calloc(1, sizeof(rawImageRec));
     if (raw == NULL) {
 	return NULL;
     }
-    if ((raw->file = fopen(fileName, "rb")) == NULL) {
+
+    fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+	free(raw);
 	return NULL;
     }
-
-    fread(raw, 1, 12, raw->file);
-
-    if (swapFlag) {
-	ConvertShort(&raw->imagic, 6);
+    if (fstat(fd, &status) < 0 || status.st_size < 512) {
+	close(fd);
+	free(raw);
+	return NULL;
     }
-
-    raw->tmp = (unsigned char *)malloc(raw->sizeX*256);
-    raw->tmpR = (unsigned char *)malloc(raw->sizeX*256);
-    raw->tmpG = (unsigned char *)malloc(raw->sizeX*256);
-    raw->tmpB = (unsigned char *)malloc(raw->sizeX*256);
-    if (raw->tmp == NULL || raw->tmpR == NULL || raw->tmpG == NULL ||
-	raw->tmpB == NULL) {
+    map = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+	free(raw);
+	return NULL;
+    }
+    raw->map = (const unsigned char *)map;
+    raw->mapLength = status.st_size;
+
+    raw->imagic = GetShort(raw->map);
+    raw->type = GetShort(raw->map + 2);
+    raw->dim = GetShort(raw->map + 4);
+    raw->sizeX = GetShort(raw->map + 6);
+    raw->sizeY = GetShort(raw->map + 8);
+    raw->sizeZ = GetShort(raw->map + 10);
+    if (raw->sizeZ == 0) {
+	RawImageClose(raw);
 	return NULL;
     }
 
+    rows = raw->sizeY * raw->sizeZ;
     if ((raw->type & 0xFF00) == 0x0100) {
-	x = raw->sizeY * raw->sizeZ * sizeof(GLuint);
+	x = rows * sizeof(GLuint);
 	raw->rowStart = (GLuint *)malloc(x);
 	raw->rowSize = (GLint *)malloc(x);
-	if (raw->rowStart == NULL || raw->rowSize == NULL) {
+	if (raw->rowStart == NULL || raw->rowSize == NULL ||
+	    raw->mapLength < 512 + 2 * (size_t)x) {
+	    RawImageClose(raw);
 	    return NULL;
 	}
-	raw->rleEnd = 512 + (2 * x);
-	fseek(raw->file, 512, SEEK_SET);
-	fread(raw->rowStart, 1, x, raw->file);
-	fread(raw->rowSize, 1, x, raw->file);
-	if (swapFlag) {
-	    ConvertLong(raw->rowStart, x/sizeof(GLuint));
-	    ConvertLong((GLuint *)raw->rowSize, x/sizeof(GLint));
+	for (x = 0; x < rows; x++) {
+	    raw->rowStart[x] = GetLong(raw->map + 512 + 4 * x);
+	    raw->rowSize[x] = GetLong(raw->map + 512 + 4 * (rows + x));
+	    if (raw->rowSize[x] < 0 ||
+		raw->rowStart[x] > raw->mapLength ||
+		(size_t)raw->rowSize[x] > raw->mapLength - raw->rowStart[x]) {
+		RawImageClose(raw);
+		return NULL;
+	    }
 	}
+    } else if (raw->mapLength < 512 + (size_t)rows * raw->sizeX) {
+	RawImageClose(raw);
+	return NULL;
     }
     return raw;
 }
 
-static void RawImageClose(rawImageRec *raw)
-{
-
-    fclose(raw->file);
-    free(raw->tmp);
-    free(raw->tmpR);
-    free(raw->tmpG);
-    free(raw->tmpB);
-
-    free(raw);
-}
-
+/* RawImageGetRow: Decodes row y of channel z, the sizeX bytes of which
+ * go to buf, followed by ROW_SLACK bytes that may be overwritten; bytes
+ * an RLE row leaves short are zero.
+ */
 static void RawImageGetRow(rawImageRec *raw, unsigned char *buf, int y, int z)
 {
-  unsigned char *iPtr, *oPtr, pixel;
+  const unsigned char *iPtr, *iEnd;
+  unsigned char *oPtr, *oEnd, pixel;
   int count;
+#ifdef __SSE2__
+  __m128i run;
+  int k;
+#endif
+
+  /* Images of fewer channels repeat their last, so gray stays gray. */
+  if (z >= raw->sizeZ) {
+    z = raw->sizeZ - 1;
+  }
 
   if ((raw->type & 0xFF00) == 0x0100) {
-    fseek(raw->file, raw->rowStart[y+z*raw->sizeY], SEEK_SET);
-    fread(raw->tmp, 1, (unsigned int)raw->rowSize[y+z*raw->sizeY],
-	  raw->file);
-
-    iPtr = raw->tmp;
+    iPtr = raw->map + raw->rowStart[y+z*raw->sizeY];
+    iEnd = iPtr + raw->rowSize[y+z*raw->sizeY];
     oPtr = buf;
-    while (1) {
+    oEnd = buf + raw->sizeX;
+    while (iPtr < iEnd) {
       pixel = *iPtr++;
       count = (int)(pixel & 0x7F);
-      if (!count) {
-	return;
+      if (!count || count > oEnd - oPtr) {
+	break;
       }
       if (pixel & 0x80) {
-	while (count--) {
-	  *oPtr++ = *iPtr++;
+	if (count > iEnd - iPtr) {
+	  break;
 	}
+#ifdef __SSE2__
+	/* 16 bytes at a time unless that would read past the mapping. */
+	if ((size_t)(iPtr - raw->map) + count + 15 < raw->mapLength) {
+	  for (k = 0; k < count; k += 16) {
+	    _mm_storeu_si128((__m128i *)(oPtr + k),
+			     _mm_loadu_si128((const __m128i *)(iPtr + k)));
+	  }
+	} else
+#endif
+	memcpy(oPtr, iPtr, count);
+	iPtr += count;
       } else {
-	pixel = *iPtr++;
-	while (count--) {
-	  *oPtr++ = pixel;
+	if (iPtr == iEnd) {
+	  break;
+	}
+#ifdef __SSE2__
+	run = _mm_set1_epi8(*iPtr++);
+	for (k = 0; k < count; k += 16) {
+	  _mm_storeu_si128((__m128i *)(oPtr + k), run);
 	}
+#else
+	memset(oPtr, *iPtr++, count);
+#endif
       }
+      oPtr += count;
     }
+    memset(oPtr, 0, oEnd - oPtr);
   } else {
-    fseek(raw->file, 512+(y*raw->sizeX)+(z*raw->sizeX*raw->sizeY),
-	  SEEK_SET);
-    fread(buf, 1, raw->sizeX, raw->file);
+    memcpy(buf, raw->map + 512 + (y*raw->sizeX) + (z*raw->sizeX*raw->sizeY),
+	   raw->sizeX);
+  }
+}
+
+static void InterleaveScalar(const unsigned char *r, const unsigned char *g,
+			     const unsigned char *b, unsigned char *out,
+			     int count)
+{
+  int j;
+
+  for (j = 0; j < count; j++) {
+    *out++ = r[j];
+    *out++ = g[j];
+    *out++ = b[j];
   }
 }
 
+#ifdef GLTX_X86
+/* Shuffles of 16 pixels' r, g and b to their places in output bytes
+ * 16 * block to 16 * block + 15; -1 places a zero.
+ */
+static const signed char interleaveMasks[3][3][16] = {
+  { { 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5 },
+    { -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1 },
+    { -1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1 } },
+  { { -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1 },
+    { 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10 },
+    { -1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1 } },
+  { { -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1 },
+    { -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1 },
+    { 10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15 } }
+};
+
+__attribute__((target("ssse3")))
+static void InterleaveSSSE3(const unsigned char *r, const unsigned char *g,
+			    const unsigned char *b, unsigned char *out,
+			    int count)
+{
+  __m128i vr, vg, vb;
+  int j, block;
+
+  for (j = 0; j + 16 <= count; j += 16) {
+    vr = _mm_loadu_si128((const __m128i *)(r + j));
+    vg = _mm_loadu_si128((const __m128i *)(g + j));
+    vb = _mm_loadu_si128((const __m128i *)(b + j));
+    for (block = 0; block < 3; block++) {
+      _mm_storeu_si128((__m128i *)(out + 3 * j + 16 * block),
+	_mm_or_si128(_mm_or_si128(
+	  _mm_shuffle_epi8(vr, _mm_loadu_si128((const __m128i *)
+					       interleaveMasks[block][0])),
+	  _mm_shuffle_epi8(vg, _mm_loadu_si128((const __m128i *)
+					       interleaveMasks[block][1]))),
+	  _mm_shuffle_epi8(vb, _mm_loadu_si128((const __m128i *)
+					       interleaveMasks[block][2]))));
+    }
+  }
+  InterleaveScalar(r + j, g + j, b + j, out + 3 * j, count - j);
+}
+
+/* The 256-bit mask of output blocks low and high. */
+__attribute__((target("avx2")))
+static __m256i InterleaveMask(int low, int high, int channel)
+{
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(
+    _mm_loadu_si128((const __m128i *)interleaveMasks[low][channel])),
+    _mm_loadu_si128((const __m128i *)interleaveMasks[high][channel]), 1);
+}
+
+/* Shuffles work within 128-bit lanes, so each 32-byte output is built
+ * from pixels 0 to 15 in both lanes, 0 to 15 and 16 to 31, or 16 to 31
+ * in both, the three outputs' blocks being 0 and 1, 2 and 0, and 1 and 2.
+ */
+__attribute__((target("avx2")))
+static void InterleaveAVX2(const unsigned char *r, const unsigned char *g,
+			   const unsigned char *b, unsigned char *out,
+			   int count)
+{
+  static const int blocks[3][2] = { { 0, 1 }, { 2, 0 }, { 1, 2 } };
+  __m256i masks[3][3], in[3], source;
+  int j, k, c;
+
+  for (k = 0; k < 3; k++) {
+    for (c = 0; c < 3; c++) {
+      masks[k][c] = InterleaveMask(blocks[k][0], blocks[k][1], c);
+    }
+  }
+  for (j = 0; j + 32 <= count; j += 32) {
+    in[0] = _mm256_loadu_si256((const __m256i *)(r + j));
+    in[1] = _mm256_loadu_si256((const __m256i *)(g + j));
+    in[2] = _mm256_loadu_si256((const __m256i *)(b + j));
+    for (k = 0; k < 3; k++) {
+      __m256i sum = _mm256_setzero_si256();
+      for (c = 0; c < 3; c++) {
+	if (k == 0) {
+	  source = _mm256_permute2x128_si256(in[c], in[c], 0x00);
+	} else if (k == 1) {
+	  source = in[c];
+	} else {
+	  source = _mm256_permute2x128_si256(in[c], in[c], 0x11);
+	}
+	sum = _mm256_or_si256(sum, _mm256_shuffle_epi8(source, masks[k][c]));
+      }
+      _mm256_storeu_si256((__m256i *)(out + 3 * j + 32 * k), sum);
+    }
+  }
+  InterleaveSSSE3(r + j, g + j, b + j, out + 3 * j, count - j);
+}
+#endif
+
+/* ChooseInterleave: Returns the fastest interleave routine the processor
+ * runs.
+ */
+static interleaveFunc ChooseInterleave(void)
+{
+  if (getenv("GLTX_NO_SIMD") != NULL) {
+    return InterleaveScalar;
+  }
+#ifdef GLTX_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return InterleaveAVX2;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    return InterleaveSSSE3;
+  }
+#endif
+  return InterleaveScalar;
+}
+
+/* RawImageDecodeBands: Decodes bands of a job into its image until none
+ * are left.
+ */
+static void *RawImageDecodeBands(void *arg)
+{
+  rawDecodeThread *thread = (rawDecodeThread *)arg;
+  rawImageRec *raw = thread->job->raw;
+  int band, i;
+
+  while ((band = atomic_fetch_add(&thread->job->nextBand, 1)) * BAND_ROWS <
+	 raw->sizeY) {
+    for (i = band * BAND_ROWS; i < (band + 1) * BAND_ROWS && i < raw->sizeY;
+	 i++) {
+      RawImageGetRow(raw, thread->tmpR, i, 0);
+      RawImageGetRow(raw, thread->tmpG, i, 1);
+      RawImageGetRow(raw, thread->tmpB, i, 2);
+      thread->job->interleave(thread->tmpR, thread->tmpG, thread->tmpB,
+			      thread->job->data + 3 * (size_t)raw->sizeX * i,
+			      raw->sizeX);
+    }
+  }
+  return NULL;
+}
+
 static void
 RawImageGetData(rawImageRec *raw, GLTXimage *image)
 {
-  unsigned char *ptr;
-  int i, j;
+  rawDecodeJob job;
+  rawDecodeThread threads[MAX_THREADS];
+  pthread_t ids[MAX_THREADS];
+  unsigned char *rows;
+  long count, started, t;
+  int bands = (raw->sizeY + BAND_ROWS - 1) / BAND_ROWS;
 
   image->data = (unsigned char *)malloc((raw->sizeX+1)*(raw->sizeY+1)*4);
   if (image->data == NULL) {
     return;
   }
 
-  ptr = image->data;
-  for (i = 0; i < raw->sizeY; i++) {
-    RawImageGetRow(raw, raw->tmpR, i, 0);
-    RawImageGetRow(raw, raw->tmpG, i, 1);
-    RawImageGetRow(raw, raw->tmpB, i, 2);
-    for (j = 0; j < raw->sizeX; j++) {
-      *ptr++ = *(raw->tmpR + j);
-      *ptr++ = *(raw->tmpG + j);
-      *ptr++ = *(raw->tmpB + j);
+  /* One thread per processor, but no more than there are bands, and
+   * only one for small images, not worth starting threads for.
+   */
+  count = sysconf(_SC_NPROCESSORS_ONLN);
+  if (count > MAX_THREADS) {
+    count = MAX_THREADS;
+  }
+  if (count > bands) {
+    count = bands;
+  }
+  if (count < 1 || (long)raw->sizeX * raw->sizeY < PARALLEL_PIXELS) {
+    count = 1;
+  }
+
+  rows = (unsigned char *)malloc(count * 3 * (raw->sizeX + ROW_SLACK));
+  if (rows == NULL) {
+    free(image->data);
+    image->data = NULL;
+    return;
+  }
+  job.raw = raw;
+  job.data = image->data;
+  job.interleave = ChooseInterleave();
+  atomic_init(&job.nextBand, 0);
+  for (t = 0; t < count; t++) {
+    threads[t].job = &job;
+    threads[t].tmpR = rows + 3 * t * (raw->sizeX + ROW_SLACK);
+    threads[t].tmpG = threads[t].tmpR + raw->sizeX + ROW_SLACK;
+    threads[t].tmpB = threads[t].tmpG + raw->sizeX + ROW_SLACK;
+  }
+
+  /* This thread decodes too, and takes any bands of threads that fail
+   * to start.
+   */
+  for (started = 1; started < count; started++) {
+    if (pthread_create(&ids[started], NULL, RawImageDecodeBands,
+		       &threads[started]) != 0) {
+      break;
     }
   }
+  RawImageDecodeBands(&threads[0]);
+  for (t = 1; t < started; t++) {
+    pthread_join(ids[t], NULL);
+  }
+  free(rows);
 }
 
 
@@ -0,0 +1,198 @@
+/* gltxBench.c --- Timing of the IRIS RGB reader of gltx.c.
+ *
+ * Writes three synthetic size x size RGB images (default 4096):
+ * an RLE image of short runs and literals, as photographs encode, an
+ * RLE image of long flat runs and a verbatim image.  Each is then read
+ * with gltxReadRGB() reps times (default 5), once with the SIMD
+ * interleaving gltx.c picks for the processor and once with
+ * GLTX_NO_SIMD set, and the best time of each reported.
+ *
+ * Usage: ./gltxBench [size [reps]]
+ *
+ * The images are written to the current directory and removed after.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gltx.h"
+
+#define MAX_RUN 127
+
+enum { PHOTO, FLAT, VERBATIM, KINDS };
+
+static const char *kindNames[KINDS] = { "RLE photo", "RLE flat", "verbatim" };
+static const char *fileNames[KINDS] = {
+  "gltxBench-photo.rgb", "gltxBench-flat.rgb", "gltxBench-verbatim.rgb"
+};
+
+
+/* Big-endian values of the file. */
+static void PutShort(unsigned char *ptr, unsigned short value)
+{
+  ptr[0] = value >> 8;
+  ptr[1] = value;
+}
+
+static void PutLong(unsigned char *ptr, unsigned long value)
+{
+  ptr[0] = value >> 24;
+  ptr[1] = value >> 16;
+  ptr[2] = value >> 8;
+  ptr[3] = value;
+}
+
+/* Fills row y of channel z of an image of the given kind. */
+static void MakeRow(int kind, unsigned char *row, int size, int y, int z)
+{
+  int x;
+
+  for (x = 0; x < size; x++) {
+    if (kind == FLAT) {
+      row[x] = (x / 37 + y / 29 + z) & 0xFF;
+    } else if (rand() % 4) {
+      row[x] = (x / 5 + y + z) & 0xFF;
+    } else {
+      row[x] = rand() & 0xFF;
+    }
+  }
+}
+
+/* Encodes row as RLE into out, returning the bytes written. */
+static int EncodeRow(const unsigned char *row, int size, unsigned char *out)
+{
+  int n = 0, x = 0, start, count;
+
+  while (x < size) {
+    for (count = 1; x + count < size && count < MAX_RUN &&
+	 row[x + count] == row[x]; count++);
+    if (count > 1) {
+      out[n++] = count;
+      out[n++] = row[x];
+      x += count;
+    } else {
+      /* Literals up to the next run of two. */
+      start = x;
+      for (count = 0; x < size && count < MAX_RUN &&
+	   (count == 0 || x + 1 >= size || row[x + 1] != row[x]); x++, count++);
+      out[n++] = 0x80 | count;
+      memcpy(out + n, row + start, count);
+      n += count;
+    }
+  }
+  out[n++] = 0;
+  return n;
+}
+
+/* Writes an image of the given kind to fileName; returns 0 on failure. */
+static int WriteImage(int kind, const char *fileName, int size)
+{
+  unsigned char header[512], *row, *out, *table;
+  unsigned long offset;
+  FILE *file;
+  int rows = 3 * size, i, n;
+
+  file = fopen(fileName, "wb");
+  row = (unsigned char *)malloc(size);
+  out = (unsigned char *)malloc(2 * size + 2);
+  table = (unsigned char *)calloc(rows, 8);
+  if (file == NULL || row == NULL || out == NULL || table == NULL) {
+    return 0;
+  }
+
+  memset(header, 0, sizeof(header));
+  PutShort(header, 474);
+  PutShort(header + 2, kind == VERBATIM ? 0x0001 : 0x0101);
+  PutShort(header + 4, 3);
+  PutShort(header + 6, size);
+  PutShort(header + 8, size);
+  PutShort(header + 10, 3);
+  fwrite(header, 1, sizeof(header), file);
+
+  srand(1);
+  if (kind == VERBATIM) {
+    for (i = 0; i < rows; i++) {
+      MakeRow(PHOTO, row, size, i % size, i / size);
+      fwrite(row, 1, size, file);
+    }
+  } else {
+    /* Rows after the table, which is filled in as they are written. */
+    fwrite(table, 8, rows, file);
+    offset = 512 + 8 * rows;
+    for (i = 0; i < rows; i++) {
+      MakeRow(kind, row, size, i % size, i / size);
+      n = EncodeRow(row, size, out);
+      fwrite(out, 1, n, file);
+      PutLong(table + 4 * i, offset);
+      PutLong(table + 4 * (rows + i), n);
+      offset += n;
+    }
+    fseek(file, 512, SEEK_SET);
+    fwrite(table, 8, rows, file);
+  }
+
+  free(row);
+  free(out);
+  free(table);
+  return fclose(file) == 0;
+}
+
+/* Returns the best seconds of reps reads of fileName. */
+static double TimeRead(const char *fileName, int reps)
+{
+  struct timespec start, end;
+  GLTXimage *image;
+  double seconds, best = 0.0;
+  int i;
+
+  for (i = 0; i < reps; i++) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    image = gltxReadRGB((char *)fileName);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (image == NULL) {
+      return -1.0;
+    }
+    gltxDelete(image);
+    seconds = (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+    if (i == 0 || seconds < best) {
+      best = seconds;
+    }
+  }
+  return best;
+}
+
+int main(int argc, char **argv)
+{
+  int size = argc > 1 ? atoi(argv[1]) : 4096;
+  int reps = argc > 2 ? atoi(argv[2]) : 5;
+  double megabytes, simd, scalar;
+  int kind;
+
+  if (size < 1 || size > 65535 || reps < 1) {
+    fprintf(stderr, "Usage: %s [size [reps]]\n", argv[0]);
+    return 1;
+  }
+  megabytes = 3.0 * size * size / 1e6;
+
+  printf("%dx%d RGB, best of %d reads, MB/s of pixels decoded:\n",
+	 size, size, reps);
+  for (kind = 0; kind < KINDS; kind++) {
+    if (!WriteImage(kind, fileNames[kind], size)) {
+      fprintf(stderr, "Can't write %s.\n", fileNames[kind]);
+      return 1;
+    }
+    unsetenv("GLTX_NO_SIMD");
+    simd = TimeRead(fileNames[kind], reps);
+    setenv("GLTX_NO_SIMD", "1", 1);
+    scalar = TimeRead(fileNames[kind], reps);
+    remove(fileNames[kind]);
+    if (simd < 0.0 || scalar < 0.0) {
+      fprintf(stderr, "Can't read %s.\n", fileNames[kind]);
+      return 1;
+    }
+    printf("  %-10s  SIMD %8.1f  scalar %8.1f\n", kindNames[kind],
+	   megabytes / simd, megabytes / scalar);
+  }
+  return 0;
+}
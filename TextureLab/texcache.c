@@ -0,0 +1,594 @@
+/*
+ *  On-disk cache of mipmapped textures; see texcache.h.
+ *
+ *  A blob is a 64-byte header,
+ *
+ *      magic        8 bytes  "TEXMIPS" and a NUL
+ *      version      uint32   CACHE_VERSION
+ *      byteOrder    uint32   0x01020304 as written by the writing machine
+ *      sourceHash   uint64   hash of the IRIS RGB file
+ *      levels       uint32   number of levels
+ *      maxSize      int32    largest texture allowed when built
+ *      reserved     24 bytes zero
+ *
+ *  then for each level its width and height (uint32) and the offset of
+ *  its texels (uint64), then the texels of the levels, each starting on
+ *  a multiple of 64 bytes.
+ */
+
+
+/* includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "gltx.h"
+#include "texcache.h"
+
+
+/* private defines */
+#define CACHE_DIR ".texcache"
+#define CACHE_MAGIC "TEXMIPS"
+#define CACHE_VERSION 2
+#define CACHE_BYTE_ORDER 0x01020304
+#define HEADER_BYTES 64
+#define LEVEL_BYTES 16			/* bytes of a level's table entry */
+#define ALIGN 64
+
+
+/* private functions */
+
+/* HashFile: Sets *hash to the 64-bit FNV-1a hash, taken a word at a time,
+ * of the contents of file name.  Returns 0 if it can't be read.
+ */
+static int HashFile(const char *name, uint64_t *hash)
+{
+  const unsigned char *ptr;
+  struct stat status;
+  uint64_t word, h = 14695981039346656037ULL;
+  void *map;
+  size_t i, length;
+  int fd;
+
+  fd = open(name, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  if (fstat(fd, &status) < 0) {
+    close(fd);
+    return 0;
+  }
+  length = status.st_size;
+  map = length ? mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+  close(fd);
+  if (map == MAP_FAILED) {
+    return 0;
+  }
+
+  ptr = (const unsigned char *)map;
+  for (i = 0; i + 8 <= length; i += 8) {
+    memcpy(&word, ptr + i, 8);
+    h = (h ^ word) * 1099511628211ULL;
+  }
+  for (; i < length; i++) {
+    h = (h ^ ptr[i]) * 1099511628211ULL;
+  }
+  h = (h ^ length) * 1099511628211ULL;
+
+  if (map != NULL) {
+    munmap(map, length);
+  }
+  *hash = h;
+  return 1;
+}
+
+/* ParseBlob: Points image at the levels of the blob of length bytes, if
+ * it is a blob of the source of hash built for maxSize.  Returns 0 if it
+ * is not.
+ */
+static int ParseBlob(const unsigned char *blob, size_t length, uint64_t hash,
+		     GLint maxSize, TEXCACHEimage *image)
+{
+  uint32_t version, byteOrder, levels, width, height;
+  GLint blobMaxSize;
+  uint64_t sourceHash, offset;
+  GLuint i;
+
+  if (length < HEADER_BYTES || memcmp(blob, CACHE_MAGIC, 8) != 0) {
+    return 0;
+  }
+  memcpy(&version, blob + 8, 4);
+  memcpy(&byteOrder, blob + 12, 4);
+  memcpy(&sourceHash, blob + 16, 8);
+  memcpy(&levels, blob + 24, 4);
+  memcpy(&blobMaxSize, blob + 28, 4);
+  if (version != CACHE_VERSION || byteOrder != CACHE_BYTE_ORDER ||
+      sourceHash != hash || blobMaxSize != maxSize || levels < 1 || levels > TEXCACHE_MAX_LEVELS ||
+      length < HEADER_BYTES + (size_t)LEVEL_BYTES * levels) {
+    return 0;
+  }
+
+  image->levels = levels;
+  for (i = 0; i < levels; i++) {
+    memcpy(&width, blob + HEADER_BYTES + LEVEL_BYTES * i, 4);
+    memcpy(&height, blob + HEADER_BYTES + LEVEL_BYTES * i + 4, 4);
+    memcpy(&offset, blob + HEADER_BYTES + LEVEL_BYTES * i + 8, 8);
+    if (width < 1 || height < 1 || offset > length ||
+	(length - offset) / 4 / width < height) {
+      return 0;
+    }
+    image->width[i] = width;
+    image->height[i] = height;
+    image->data[i] = blob + offset;
+  }
+  return 1;
+}
+
+/* ReadBlob: Maps the blob at path into image if it is one of the source
+ * of hash built for maxSize.  Returns 0 if it is not.
+ */
+static int ReadBlob(const char *path, uint64_t hash, GLint maxSize,
+		    TEXCACHEimage *image)
+{
+  struct stat status;
+  void *map;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  if (fstat(fd, &status) < 0 || status.st_size < HEADER_BYTES) {
+    close(fd);
+    return 0;
+  }
+  map = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return 0;
+  }
+  if (!ParseBlob((const unsigned char *)map, status.st_size, hash, maxSize,
+		 image)) {
+    munmap(map, status.st_size);
+    return 0;
+  }
+  image->map = map;
+  image->mapLength = status.st_size;
+  image->mapped = 1;
+  return 1;
+}
+
+/* NearestPower: Returns the power of two gluBuild2DMipmaps() scales a
+ * dimension of size to: the power below, or above where the two bits
+ * after the highest are both set.
+ */
+static GLuint NearestPower(GLuint size)
+{
+  GLuint power = 1;
+
+  while (size > 1) {
+    if (size == 3) {
+      return 4 * power;
+    }
+    size >>= 1;
+    power *= 2;
+  }
+  return power;
+}
+
+/* HalveLevel: Writes to out the level of width x height RGBA texels in
+ * halved, as gluBuild2DMipmaps() does: each 2x2 block averaged, rounded,
+ * or once a dimension is down to 1, each pair averaged, truncated.
+ */
+static void HalveLevel(const GLubyte *in, GLuint width, GLuint height,
+		       GLubyte *out)
+{
+  GLuint outWidth = width > 1 ? width / 2 : 1;
+  GLuint outHeight = height > 1 ? height / 2 : 1;
+  GLuint dx = width > 1 ? 4 : 0, dy = height > 1 ? 4 * width : 0;
+  GLuint x, y, c;
+  const GLubyte *ptr;
+
+  for (y = 0; y < outHeight; y++) {
+    for (x = 0; x < outWidth; x++) {
+      ptr = in + 4 * ((size_t)width * (height > 1 ? 2 * y : y) +
+		      (width > 1 ? 2 * x : x));
+      for (c = 0; c < 4; c++) {
+	if (dx && dy) {
+	  *out++ = (ptr[c] + ptr[dx + c] + ptr[dy + c] + ptr[dx + dy + c] + 2) / 4;
+	} else {
+	  *out++ = (ptr[c] + ptr[dx + dy + c]) / 2;
+	}
+      }
+    }
+  }
+}
+
+/* ScaleLevel: Writes to out the level of widthIn x heightIn RGBA texels
+ * in scaled to widthOut x heightOut, as gluBuild2DMipmaps() does for
+ * unsigned bytes (not as gluScaleImage() does, whose rounding differs):
+ * each texel out is the mean of the input under it, weighted by the area
+ * covered, reckoned in single-precision floats and truncated.  The
+ * pointers to the first and last columns of a box creep one texel right
+ * with each row inside it, as GLU's do, so in may be read up to a row and
+ * a box beyond its end; the caller pads it.
+ */
+static void ScaleLevel(const GLubyte *in, GLuint widthIn, GLuint heightIn,
+		       GLubyte *out, GLuint widthOut, GLuint heightOut)
+{
+  float convx, convy, convxFloat, convyFloat, area, percent, xPercent, yPercent;
+  float lowxFloat, highxFloat, lowyFloat, highyFloat, totals[4];
+  int convxInt, convyInt, lowxInt, highxInt, lowyInt, highyInt, l, m, k;
+  size_t rowBytes = 4 * (size_t)widthIn;
+  const GLubyte *temp, *temp0, *left, *right;
+  GLuint i, j;
+
+  if (widthIn == 2 * widthOut && heightIn == 2 * heightOut) {
+    HalveLevel(in, widthIn, heightIn, out);
+    return;
+  }
+
+  convy = (float)heightIn / heightOut;
+  convx = (float)widthIn / widthOut;
+  convyInt = (int)convy;
+  convyFloat = convy - convyInt;
+  convxInt = (int)convx;
+  convxFloat = convx - convxInt;
+  area = convx * convy;
+
+  lowyInt = 0;
+  lowyFloat = 0;
+  highyInt = convyInt;
+  highyFloat = convyFloat;
+  for (i = 0; i < heightOut; i++) {
+    if (highyInt >= (int)heightIn) {
+      highyInt = heightIn - 1;
+    }
+    lowxInt = 0;
+    lowxFloat = 0;
+    highxInt = convxInt;
+    highxFloat = convxFloat;
+
+    for (j = 0; j < widthOut; j++) {
+      totals[0] = totals[1] = totals[2] = totals[3] = 0.0f;
+      temp = in + 4 * lowxInt + lowyInt * rowBytes;
+
+      if (highyInt > lowyInt && highxInt > lowxInt) {
+	/* The first row, the last and the first and last columns. */
+	yPercent = 1 - lowyFloat;
+	percent = yPercent * (1 - lowxFloat);
+	for (k = 0; k < 4; k++) {
+	  totals[k] += temp[k] * percent;
+	}
+	left = temp;
+	for (l = lowxInt + 1; l < highxInt; l++) {
+	  temp += 4;
+	  for (k = 0; k < 4; k++) {
+	    totals[k] += temp[k] * yPercent;
+	  }
+	}
+	temp += 4;
+	right = temp;
+	percent = yPercent * highxFloat;
+	for (k = 0; k < 4; k++) {
+	  totals[k] += temp[k] * percent;
+	}
+
+	yPercent = highyFloat;
+	percent = yPercent * (1 - lowxFloat);
+	temp = in + 4 * lowxInt + highyInt * rowBytes;
+	for (k = 0; k < 4; k++) {
+	  totals[k] += temp[k] * percent;
+	}
+	for (l = lowxInt + 1; l < highxInt; l++) {
+	  temp += 4;
+	  for (k = 0; k < 4; k++) {
+	    totals[k] += temp[k] * yPercent;
+	  }
+	}
+	temp += 4;
+	percent = yPercent * highxFloat;
+	for (k = 0; k < 4; k++) {
+	  totals[k] += temp[k] * percent;
+	}
+
+	for (m = lowyInt + 1; m < highyInt; m++) {
+	  left += rowBytes;
+	  right += rowBytes;
+	  for (k = 0; k < 4; k++) {
+	    totals[k] += left[k] * (1 - lowxFloat) + right[k] * highxFloat;
+	  }
+	  left += 4;
+	  right += 4;
+	}
+      } else if (highyInt > lowyInt) {
+	/* Within one column. */
+	xPercent = highxFloat - lowxFloat;
+	percent = (1 - lowyFloat) * xPercent;
+	for (k = 0; k < 4; k++) {
+	  totals[k] += temp[k] * percent;
+	}
+	for (m = lowyInt + 1; m < highyInt; m++) {
+	  temp += rowBytes;
+	  for (k = 0; k < 4; k++) {
+	    totals[k] += temp[k] * xPercent;
+	  }
+	}
+	percent = xPercent * highyFloat;
+	temp += rowBytes;
+	for (k = 0; k < 4; k++) {
+	  totals[k] += temp[k] * percent;
+	}
+      } else if (highxInt > lowxInt) {
+	/* Within one row. */
+	yPercent = highyFloat - lowyFloat;
+	percent = (1 - lowxFloat) * yPercent;
+	for (k = 0; k < 4; k++) {
+	  totals[k] += temp[k] * percent;
+	}
+	for (l = lowxInt + 1; l < highxInt; l++) {
+	  temp += 4;
+	  for (k = 0; k < 4; k++) {
+	    totals[k] += temp[k] * yPercent;
+	  }
+	}
+	temp += 4;
+	percent = yPercent * highxFloat;
+	for (k = 0; k < 4; k++) {
+	  totals[k] += temp[k] * percent;
+	}
+      } else {
+	/* Within one texel. */
+	percent = (highyFloat - lowyFloat) * (highxFloat - lowxFloat);
+	for (k = 0; k < 4; k++) {
+	  totals[k] += temp[k] * percent;
+	}
+      }
+
+      /* The texels wholly inside. */
+      temp0 = in + 4 * lowxInt + 4 + (lowyInt + 1) * rowBytes;
+      for (m = lowyInt + 1; m < highyInt; m++) {
+	temp = temp0;
+	for (l = lowxInt + 1; l < highxInt; l++) {
+	  for (k = 0; k < 4; k++) {
+	    totals[k] += temp[k];
+	  }
+	  temp += 4;
+	}
+	temp0 += rowBytes;
+      }
+
+      for (k = 0; k < 4; k++) {
+	*out++ = totals[k] / area;
+      }
+
+      lowxInt = highxInt;
+      lowxFloat = highxFloat;
+      highxInt += convxInt;
+      highxFloat += convxFloat;
+      if (highxFloat > 1) {
+	highxFloat -= 1.0;
+	highxInt++;
+      }
+    }
+
+    lowyInt = highyInt;
+    lowyFloat = highyFloat;
+    highyInt += convyInt;
+    highyFloat += convyFloat;
+    if (highyFloat > 1) {
+      highyFloat -= 1.0;
+      highyInt++;
+    }
+  }
+}
+
+/* BuildBlob: Returns a malloc()ed blob of the levels of image, setting
+ * *length to its bytes, or NULL.
+ */
+static unsigned char *BuildBlob(GLTXimage *image, uint64_t hash,
+				GLint maxSize, size_t *length)
+{
+  GLuint width[TEXCACHE_MAX_LEVELS], height[TEXCACHE_MAX_LEVELS];
+  uint64_t offset[TEXCACHE_MAX_LEVELS];
+  uint32_t version = CACHE_VERSION, byteOrder = CACHE_BYTE_ORDER, levels;
+  GLubyte *rgba;
+  unsigned char *blob;
+  size_t i, pixels;
+  GLuint level;
+
+  /* The image as RGBA, padded for ScaleLevel(), then as
+   * gluBuild2DMipmaps() would scale it: to the nearest powers of two,
+   * both halved while either is too large.
+   */
+  pixels = (size_t)image->width * image->height;
+  rgba = (GLubyte *)calloc(pixels + 2 * image->width + image->height + 2, 4);
+  if (rgba == NULL) {
+    return NULL;
+  }
+  for (i = 0; i < pixels; i++) {
+    rgba[4 * i] = image->data[3 * i];
+    rgba[4 * i + 1] = image->data[3 * i + 1];
+    rgba[4 * i + 2] = image->data[3 * i + 2];
+    rgba[4 * i + 3] = 0xFF;
+  }
+  width[0] = NearestPower(image->width);
+  height[0] = NearestPower(image->height);
+  while (width[0] > (GLuint)maxSize || height[0] > (GLuint)maxSize) {
+    width[0] = width[0] > 1 ? width[0] / 2 : 1;
+    height[0] = height[0] > 1 ? height[0] / 2 : 1;
+  }
+
+  /* Lay out the levels. */
+  offset[0] = (HEADER_BYTES + LEVEL_BYTES * TEXCACHE_MAX_LEVELS + ALIGN - 1) /
+    ALIGN * ALIGN;
+  for (levels = 1; width[levels - 1] > 1 || height[levels - 1] > 1; levels++) {
+    width[levels] = width[levels - 1] > 1 ? width[levels - 1] / 2 : 1;
+    height[levels] = height[levels - 1] > 1 ? height[levels - 1] / 2 : 1;
+    offset[levels] = offset[levels - 1] +
+      (4 * (uint64_t)width[levels - 1] * height[levels - 1] + ALIGN - 1) /
+      ALIGN * ALIGN;
+  }
+  *length = offset[levels - 1] + 4 * (size_t)width[levels - 1] *
+    height[levels - 1];
+
+  blob = (unsigned char *)calloc(1, *length);
+  if (blob == NULL) {
+    free(rgba);
+    return NULL;
+  }
+  memcpy(blob, CACHE_MAGIC, 8);
+  memcpy(blob + 8, &version, 4);
+  memcpy(blob + 12, &byteOrder, 4);
+  memcpy(blob + 16, &hash, 8);
+  memcpy(blob + 24, &levels, 4);
+  memcpy(blob + 28, &maxSize, 4);
+  for (level = 0; level < levels; level++) {
+    memcpy(blob + HEADER_BYTES + LEVEL_BYTES * level, &width[level], 4);
+    memcpy(blob + HEADER_BYTES + LEVEL_BYTES * level + 4, &height[level], 4);
+    memcpy(blob + HEADER_BYTES + LEVEL_BYTES * level + 8, &offset[level], 8);
+  }
+
+  /* Level 0, then each from the one before. */
+  if (width[0] == image->width && height[0] == image->height) {
+    memcpy(blob + offset[0], rgba, 4 * pixels);
+  } else {
+    ScaleLevel(rgba, image->width, image->height, blob + offset[0],
+	       width[0], height[0]);
+  }
+  free(rgba);
+  for (level = 1; level < levels; level++) {
+    HalveLevel(blob + offset[level - 1], width[level - 1], height[level - 1],
+	       blob + offset[level]);
+  }
+  return blob;
+}
+
+/* WriteBlob: Writes the blob of length bytes to path, by way of a
+ * temporary file so no reader sees it part written.  Returns 0 on
+ * failure.
+ */
+static int WriteBlob(const char *path, const unsigned char *blob,
+		     size_t length)
+{
+  char temporary[96];
+  FILE *file;
+  int ok;
+
+  if (mkdir(CACHE_DIR, 0777) < 0 && errno != EEXIST) {
+    return 0;
+  }
+  snprintf(temporary, sizeof(temporary), "%s.%ld", path, (long)getpid());
+  file = fopen(temporary, "wb");
+  if (file == NULL) {
+    return 0;
+  }
+  ok = fwrite(blob, 1, length, file) == length;
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(temporary, path) < 0) {
+    remove(temporary);
+    return 0;
+  }
+  return 1;
+}
+
+
+
+/* public functions */
+
+/* texcacheLoad: Returns the mipmap levels of an IRIS RGB image file,
+ * from the cache if it has them, else from the file, adding them to
+ * the cache.  Needs a current OpenGL context, to ask the largest
+ * texture allowed.
+ *
+ * name - name of the IRIS RGB file
+ */
+TEXCACHEimage*
+texcacheLoad(char *name)
+{
+  GLint maxSize;
+
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  return texcacheLoadMax(name, maxSize);
+}
+
+/* texcacheLoadMax: As texcacheLoad(), for textures of at most maxSize
+ * texels a side.  Needs no OpenGL context and may be called from any
+ * thread.
+ *
+ * name    - name of the IRIS RGB file
+ * maxSize - largest texture allowed, as GL_MAX_TEXTURE_SIZE
+ */
+TEXCACHEimage*
+texcacheLoadMax(char *name, GLint maxSize)
+{
+  TEXCACHEimage* image;
+  GLTXimage* source;
+  unsigned char *blob;
+  char path[64];
+  uint64_t hash;
+  size_t length;
+
+  if (!HashFile(name, &hash)) {
+    fprintf(stderr, "texcacheLoad() failed: can't read image file \"%s\".\n",
+	    name);
+    return NULL;
+  }
+  image = (TEXCACHEimage*)calloc(1, sizeof(TEXCACHEimage));
+  if (image == NULL) {
+    fprintf(stderr, "texcacheLoad() failed: insufficient memory.\n");
+    return NULL;
+  }
+  snprintf(path, sizeof(path), "%s/%016llx-%d.mip", CACHE_DIR,
+	   (unsigned long long)hash, (int)maxSize);
+  if (ReadBlob(path, hash, maxSize, image)) {
+    return image;
+  }
+
+  /* Not cached: decode the file and build the levels, which are used
+   * from memory this time.
+   */
+  source = gltxReadRGB(name);
+  if (source == NULL || source->data == NULL) {
+    free(image);
+    return NULL;
+  }
+  blob = BuildBlob(source, hash, maxSize, &length);
+  gltxDelete(source);
+  if (blob == NULL) {
+    fprintf(stderr, "texcacheLoad() failed: insufficient memory.\n");
+    free(image);
+    return NULL;
+  }
+  if (!WriteBlob(path, blob, length)) {
+    fprintf(stderr, "texcacheLoad(): can't write cache file \"%s\".\n", path);
+  }
+  ParseBlob(blob, length, hash, maxSize, image);
+  image->map = blob;
+  image->mapLength = length;
+  image->mapped = 0;
+  return image;
+}
+
+/* texcacheDelete: Deletes the levels returned by texcacheLoad()
+ *
+ * image - properly initialized TEXCACHEimage structure
+ */
+void
+texcacheDelete(TEXCACHEimage* image)
+{
+  assert(image);
+
+  if (image->mapped) {
+    munmap(image->map, image->mapLength);
+  } else {
+    free(image->map);
+  }
+  free(image);
+}
@@ -0,0 +1,65 @@
+/*
+ *  On-disk cache of the mipmapped textures of IRIS RGB files, so a
+ *  program started again uploads them without decoding the files or
+ *  building their mipmaps.
+ *
+ *  An image is cached as a blob in the directory .texcache, named by a
+ *  64-bit hash of the contents of its file and the largest texture
+ *  allowed: the RGBA texels of every mipmap level, ready for
+ *  glTexImage2D().  The levels are those gluBuild2DMipmaps() builds,
+ *  texel for texel: level 0 is the image scaled to the nearest power of
+ *  two in each dimension, both halved while either is larger than
+ *  allowed, and each level after is the one before halved with a box
+ *  filter, down to 1x1.  A blob is mapped and its levels used in place.
+ */
+
+
+/* includes */
+#include <stddef.h>
+#include <GL/glut.h>
+
+
+/* defines */
+#define TEXCACHE_MAX_LEVELS 32
+
+
+/* typedefs */
+
+/* TEXCACHEimage: Structure containing the mipmap levels of an image */
+typedef struct {
+  GLuint         levels;			/* number of levels */
+  GLuint         width[TEXCACHE_MAX_LEVELS];	/* width of each level */
+  GLuint         height[TEXCACHE_MAX_LEVELS];	/* height of each level */
+  const GLubyte* data[TEXCACHE_MAX_LEVELS];	/* RGBA texels of each level */
+  void*          map;				/* the blob */
+  size_t         mapLength;
+  int            mapped;			/* is map mapped, else malloc()ed? */
+} TEXCACHEimage;
+
+
+/* texcacheLoad: Returns the mipmap levels of an IRIS RGB image file,
+ * from the cache if it has them, else from the file, adding them to
+ * the cache.  Needs a current OpenGL context, to ask the largest
+ * texture allowed.
+ *
+ * name - name of the IRIS RGB file
+ */
+TEXCACHEimage*
+texcacheLoad(char *name);
+
+/* texcacheLoadMax: As texcacheLoad(), for textures of at most maxSize
+ * texels a side.  Needs no OpenGL context and may be called from any
+ * thread.
+ *
+ * name    - name of the IRIS RGB file
+ * maxSize - largest texture allowed, as GL_MAX_TEXTURE_SIZE
+ */
+TEXCACHEimage*
+texcacheLoadMax(char *name, GLint maxSize);
+
+/* texcacheDelete: Deletes the levels returned by texcacheLoad()
+ *
+ * image - properly initialized TEXCACHEimage structure
+ */
+void
+texcacheDelete(TEXCACHEimage* image);
@@ -0,0 +1,367 @@
+/*
+ *  Streaming of textures through pixel buffer objects; see texstream.h.
+ *
+ *  A load is a job, which moves from the queue of the loader thread to
+ *  the loaded list, taken by texstreamUpdate(), and, if its levels are in
+ *  the ring, to the list of fenced uploads until OpenGL is done with
+ *  them.  The ring is allocated in order: the loader takes space at the
+ *  head, wrapping to the start when a job doesn't fit before the end,
+ *  and the render thread frees it at the tail as fences signal, which
+ *  they do in the order the jobs were allocated.
+ */
+
+
+/* includes */
+#define GL_GLEXT_PROTOTYPES
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "texcache.h"
+#include "texstream.h"
+
+
+/* private defines */
+#define RING_BYTES (16 << 20)		/* pixel buffer memory for uploads */
+#define ALIGN 64
+
+
+/* private typedefs */
+
+/* StreamJob: a texture being loaded */
+typedef struct StreamJob {
+  GLuint         texture;
+  char*          name;
+  int            mipmaps;
+  int            failed;			/* couldn't be read? */
+  GLuint         levels;
+  GLuint         width[TEXCACHE_MAX_LEVELS];
+  GLuint         height[TEXCACHE_MAX_LEVELS];
+  size_t         offset[TEXCACHE_MAX_LEVELS];	/* of each level in the ring */
+  size_t         ringBytes;		/* ring space held, 0 if none */
+  TEXCACHEimage* image;			/* levels not in the ring, or NULL */
+  GLsync         fence;			/* signalled when uploaded */
+  struct StreamJob* next;
+} StreamJob;
+
+/* StreamList: a FIFO of jobs */
+typedef struct {
+  StreamJob*  head;
+  StreamJob** tail;
+} StreamList;
+
+
+/* private data */
+
+/* Shared with the loader thread, under lock.  wake is signalled when a
+ * job is queued or ring space freed.
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static StreamList queued = { NULL, &queued.head };
+static StreamList loaded = { NULL, &loaded.head };
+static size_t ringHead, ringTail, ringUsed;
+
+/* Set by texstreamInit() */
+static int threadStarted;
+static GLint maxSize;
+static GLuint ring;			/* pixel buffer object, or 0 */
+static unsigned char *ringMap;
+
+/* Render thread only */
+static StreamList fenced = { NULL, &fenced.head };
+static int pending;
+
+
+/* private functions */
+
+static void ListAppend(StreamList *list, StreamJob *job)
+{
+  job->next = NULL;
+  *list->tail = job;
+  list->tail = &job->next;
+}
+
+static StreamJob *ListPop(StreamList *list)
+{
+  StreamJob *job = list->head;
+
+  if (job) {
+    list->head = job->next;
+    if (list->head == NULL) {
+      list->tail = &list->head;
+    }
+  }
+  return job;
+}
+
+static void JobDelete(StreamJob *job)
+{
+  if (job->image) {
+    texcacheDelete(job->image);
+  }
+  free(job->name);
+  free(job);
+}
+
+/* HasBufferStorage: Returns whether the context has glBufferStorage(). */
+static int HasBufferStorage(void)
+{
+  const char *version = (const char *)glGetString(GL_VERSION);
+  const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+  int major, minor;
+
+  if (version && sscanf(version, "%d.%d", &major, &minor) == 2 &&
+      (major > 4 || (major == 4 && minor >= 4))) {
+    return 1;
+  }
+  return extensions && strstr(extensions, "GL_ARB_buffer_storage") != NULL;
+}
+
+/* RingAlloc: Takes bytes of ring space, under lock.  Returns its offset,
+ * setting *held to the space to free for it (including any skipped at the
+ * end of the ring), or -1 if there isn't room yet.
+ */
+static long RingAlloc(size_t bytes, size_t *held)
+{
+  size_t offset;
+
+  if (ringUsed == 0) {
+    ringHead = ringTail = 0;
+  }
+  if (ringUsed == RING_BYTES) {
+    return -1;
+  }
+  if (ringHead >= ringTail) {
+    if (RING_BYTES - ringHead >= bytes) {
+      offset = ringHead;
+      *held = bytes;
+    } else if (ringTail >= bytes) {
+      offset = 0;
+      *held = RING_BYTES - ringHead + bytes;
+    } else {
+      return -1;
+    }
+  } else if (ringTail - ringHead >= bytes) {
+    offset = ringHead;
+    *held = bytes;
+  } else {
+    return -1;
+  }
+  ringHead = (offset + bytes) % RING_BYTES;
+  ringUsed += *held;
+  return offset;
+}
+
+/* LoadJob: Reads the levels of a job, into the ring if useRing and they
+ * fit, else leaving them in job->image.
+ */
+static void LoadJob(StreamJob *job, int useRing)
+{
+  TEXCACHEimage *image = texcacheLoadMax(job->name, maxSize);
+  size_t bytes = 0;
+  long offset;
+  GLuint level;
+
+  if (image == NULL) {
+    job->failed = 1;
+    return;
+  }
+
+  job->levels = job->mipmaps ? image->levels : 1;
+  for (level = 0; level < job->levels; level++) {
+    job->width[level] = image->width[level];
+    job->height[level] = image->height[level];
+    job->offset[level] = bytes;
+    bytes += ((size_t)4 * image->width[level] * image->height[level] +
+	      ALIGN - 1) & ~(size_t)(ALIGN - 1);
+  }
+
+  if (!useRing || bytes > RING_BYTES) {
+    job->image = image;
+    return;
+  }
+
+  pthread_mutex_lock(&lock);
+  while ((offset = RingAlloc(bytes, &job->ringBytes)) < 0) {
+    pthread_cond_wait(&wake, &lock);
+  }
+  pthread_mutex_unlock(&lock);
+
+  for (level = 0; level < job->levels; level++) {
+    job->offset[level] += offset;
+    memcpy(ringMap + job->offset[level], image->data[level],
+	   (size_t)4 * image->width[level] * image->height[level]);
+  }
+  texcacheDelete(image);
+}
+
+/* LoaderThread: Loads the queued jobs, forever. */
+static void *LoaderThread(void *arg)
+{
+  StreamJob *job;
+
+  for (;;) {
+    pthread_mutex_lock(&lock);
+    while (queued.head == NULL) {
+      pthread_cond_wait(&wake, &lock);
+    }
+    job = ListPop(&queued);
+    pthread_mutex_unlock(&lock);
+
+    LoadJob(job, ringMap != NULL);
+
+    pthread_mutex_lock(&lock);
+    ListAppend(&loaded, job);
+    pthread_mutex_unlock(&lock);
+  }
+  return NULL;
+}
+
+/* UploadJob: Gives the bound texture the levels of a job. */
+static void UploadJob(StreamJob *job)
+{
+  const GLvoid *data;
+  GLuint level;
+
+  if (job->ringBytes) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring);
+  }
+  for (level = 0; level < job->levels; level++) {
+    if (job->ringBytes) {
+      data = (const GLvoid *)(uintptr_t)job->offset[level];
+    } else {
+      data = job->image->data[level];
+    }
+    /* Not glTexSubImage2D(): the placeholder is 1x1. */
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, job->width[level],
+		 job->height[level], 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, job->levels - 1);
+  if (job->ringBytes) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+}
+
+
+/* public functions */
+
+void
+texstreamInit(void)
+{
+  pthread_t thread;
+
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+  if (HasBufferStorage()) {
+    glGenBuffers(1, &ring);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, RING_BYTES, NULL,
+		    GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+		    GL_MAP_COHERENT_BIT);
+    ringMap = (unsigned char *)
+      glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, RING_BYTES,
+		       GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+		       GL_MAP_COHERENT_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (ringMap == NULL) {
+      glDeleteBuffers(1, &ring);
+      ring = 0;
+    }
+  }
+
+  /* Without the thread, texstreamLoad() loads as it's called. */
+  if (pthread_create(&thread, NULL, LoaderThread, NULL) == 0) {
+    pthread_detach(thread);
+    threadStarted = 1;
+  }
+}
+
+void
+texstreamLoad(GLuint texture, char *name, int mipmaps)
+{
+  static const GLubyte grey[4] = { 128, 128, 128, 255 };
+  StreamJob *job;
+
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+	       GL_UNSIGNED_BYTE, grey);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+  job = (StreamJob *)calloc(1, sizeof(StreamJob));
+  if (job == NULL || (job->name = strdup(name)) == NULL) {
+    fprintf(stderr, "texstreamLoad() failed: insufficient memory.\n");
+    free(job);
+    return;
+  }
+  job->texture = texture;
+  job->mipmaps = mipmaps;
+  pending++;
+
+  if (!threadStarted) {
+    LoadJob(job, 0);
+    pthread_mutex_lock(&lock);
+    ListAppend(&loaded, job);
+    pthread_mutex_unlock(&lock);
+    return;
+  }
+  pthread_mutex_lock(&lock);
+  ListAppend(&queued, job);
+  pthread_cond_signal(&wake);
+  pthread_mutex_unlock(&lock);
+}
+
+int
+texstreamUpdate(void)
+{
+  StreamList done;
+  StreamJob *job;
+  GLint bound;
+  GLenum status;
+
+  /* Free the ring space of finished uploads. */
+  while (fenced.head) {
+    status = glClientWaitSync(fenced.head->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      break;
+    }
+    job = ListPop(&fenced);
+    glDeleteSync(job->fence);
+    pthread_mutex_lock(&lock);
+    ringTail = (ringTail + job->ringBytes) % RING_BYTES;
+    ringUsed -= job->ringBytes;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    JobDelete(job);
+  }
+
+  pthread_mutex_lock(&lock);
+  done = loaded;
+  if (done.head == NULL) {
+    done.tail = &done.head;
+  }
+  loaded.head = NULL;
+  loaded.tail = &loaded.head;
+  pthread_mutex_unlock(&lock);
+
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+  while ((job = ListPop(&done)) != NULL) {
+    pending--;
+    if (job->failed) {
+      JobDelete(job);
+      continue;
+    }
+    glBindTexture(GL_TEXTURE_2D, job->texture);
+    UploadJob(job);
+    if (job->ringBytes) {
+      job->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      ListAppend(&fenced, job);
+    } else {
+      JobDelete(job);
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D, bound);
+
+  return pending;
+}
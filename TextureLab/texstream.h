@@ -0,0 +1,46 @@
+/*
+ *  Streaming of textures from IRIS RGB files, so a program draws its
+ *  first frames while the textures are still being read.
+ *
+ *  A texture asked for holds a 1x1 grey placeholder at once.  A loader
+ *  thread reads its file through texcache.c and copies the mipmap levels
+ *  into a ring of pixel buffer memory, mapped persistently; each frame
+ *  the render thread hands the finished ones to OpenGL from there, which
+ *  copies them to the texture without stalling the frame, and a fence on
+ *  the upload tells when the ring space may be written again.  Without
+ *  glBufferStorage() (OpenGL 4.4 or GL_ARB_buffer_storage), or for
+ *  textures too large for the ring, the levels are uploaded from the
+ *  cache's memory instead.
+ */
+
+
+/* includes */
+#include <GL/glut.h>
+
+
+/* public functions */
+
+/* texstreamInit: Starts the loader thread.  Needs a current OpenGL
+ * context, which every other call must then use too.
+ */
+void
+texstreamInit(void);
+
+/* texstreamLoad: Gives a texture a placeholder and queues the loading
+ * of an IRIS RGB file into it.  The binding of GL_TEXTURE_2D is left
+ * as texture.
+ *
+ * texture - texture name, as from glGenTextures()
+ * name    - name of the IRIS RGB file
+ * mipmaps - load every mipmap level, else only level 0?
+ */
+void
+texstreamLoad(GLuint texture, char *name, int mipmaps);
+
+/* texstreamUpdate: Uploads the textures loaded since the last call and
+ * frees the ring space of uploads OpenGL has finished.  Call it once a
+ * frame.  A texture whose file can't be read keeps its placeholder.
+ * Returns the number of textures still loading.
+ */
+int
+texstreamUpdate(void);
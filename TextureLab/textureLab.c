@@ -22,6 +22,12 @@
  * The four texture files, imgfile[1-4].rgb should be in the main
  * project directory.
  *
+ * Textures are read through the cache of texcache.c, which keeps the
+ * mipmap levels of each file in the directory .texcache, so starting
+ * again neither decodes the files nor builds their mipmaps.  Delete
+ * the directory to empty the cache.  They are read in the background
+ * by texstream.c, the objects showing plain grey until each is loaded.
+ *
  *
  * Experiments:
  *
@@ -53,6 +59,9 @@
 #include <GL/glut.h>
 // The IRIS RGB "library."  gltx.c must be added to the project.
 #include "gltx.h"
+// Loading of the textures in the background, through the cache of
+// their mipmaps.  texstream.c and texcache.c must be added too.
+#include "texstream.h"
 
 
 // Uncomment the following to see the right cube's texture
@@ -140,16 +149,14 @@ void colorcube()
 }
 
 
-// Using gltx, read the IRIS file and bind the image to a texture.
+// Queue the IRIS file to be read, through the texture cache, into a
+// texture.  Until it has been, the texture is plain grey.
 
 void getTexture(int *tName, char *fName, int mode)
 {
-	GLTXimage *image = gltxReadRGB(fName);
-
-	if (!image)
+    if (mode != TEX_IMAGE && mode != MIP_MAP)
         {
-            printf("Problems with the image file: %s.\n",
-                   fName);
+            printf("Invalid texture mode.\n");
             exit(1);
         }
 
@@ -170,26 +177,13 @@ void getTexture(int *tName, char *fName, int mode)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
                     GL_NEAREST);
 
-    // glTexImage2D() only generates a single version of the texture.
-    // gluBuild2dMipmaps() generates several scaled versions of the
-    // texture.  It's preferable because it has fewer aliasing
-    // problems.  On the other hand, it uses more texture memory.
-
-    if (mode == TEX_IMAGE)
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image->width,
-                     image->height, 0, GL_RGB, GL_UNSIGNED_BYTE,
-                     image->data);
-    else if (mode == MIP_MAP)
-        gluBuild2DMipmaps(GL_TEXTURE_2D, 3, image->width,
-                          image->height, GL_RGB, GL_UNSIGNED_BYTE,
-                          image->data);
-    else
-        {
-            printf("Invalid texture mode.\n");
-            exit(1);
-        }
+    // Loading only level 0 gives a single version of the texture.
+    // Loading all the levels, several scaled versions, as
+    // gluBuild2dMipmaps() would generate, is preferable because it has
+    // fewer aliasing problems.  On the other hand, it uses more texture
+    // memory.  The cache has built the levels already.
 
-    gltxDelete(image);
+    texstreamLoad(*tName, fName, mode == MIP_MAP);
 }
 
 
@@ -199,6 +193,7 @@ void textureInit(void)
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
     /* Get the textures. */
+    texstreamInit();
     getTexture(texNames, "imgfile1.rgb", TEX_IMAGE);
     getTexture(texNames + 1, "imgfile2.rgb", MIP_MAP);
     getTexture(texNames + 2, "imgfile3.rgb", MIP_MAP);
@@ -224,6 +219,9 @@ void display(void)
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    // Upload any textures loaded since the last frame.
+    texstreamUpdate();
+
     glEnable(GL_TEXTURE_2D);
 
     /* Update viewer position in modelview matrix */